@@ -0,0 +1,223 @@
+/**
+\file alloc_tracking.hpp
+\brief Replacement of global \c operator \c new / \c delete, counting heap allocations during a phase
+
+Usage is similar to \c Timing: an \c AllocTracker object enables tracking when created,
+and \c PrintStats() prints what happened since then (nb of allocations, bytes, peak of live bytes,
+and an histogram of allocation sizes).
+
+Only one phase can be tracked at a time (counters are global), but allocations from all threads are counted.
+
+\warning As this header defines the global allocation functions, it must be included in only one translation unit
+(this is the case for all the programs here).
+
+Define \c NO_ALLOC_TRACKING to keep the default allocator (\c AllocTracker then does nothing).
+*/
+
+#ifndef ALLOC_TRACKING_HPP
+#define ALLOC_TRACKING_HPP
+
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+#include <iostream>
+#include <new>
+
+/// Nb of bins of the size histogram: bin \c i holds sizes in ]2^(i-1), 2^i]
+constexpr int g_alloc_nb_bins = 32;
+
+/// Global counters, updated by the allocation functions below
+struct AllocCounters
+{
+	std::atomic<bool>   enabled;
+	std::atomic<size_t> generation;
+	std::atomic<size_t> nbAlloc;
+	std::atomic<size_t> nbFree;
+	std::atomic<size_t> bytes;
+	std::atomic<size_t> live;
+	std::atomic<size_t> peakLive;
+	std::atomic<size_t> histo[g_alloc_nb_bins];
+
+	void reset()
+	{
+		nbAlloc  = 0;
+		nbFree   = 0;
+		bytes    = 0;
+		live     = 0;
+		peakLive = 0;
+		for( int i=0; i<g_alloc_nb_bins; i++ )
+			histo[i] = 0;
+	}
+};
+
+inline AllocCounters& getAllocCounters()
+{
+	static AllocCounters counters; // zero-initialized, as it has static storage duration
+	return counters;
+}
+
+#ifndef NO_ALLOC_TRACKING
+
+/// Header stored in front of each block: keeps max alignment of the returned pointer
+struct alignas(std::max_align_t) AllocHeader
+{
+	size_t size;
+	size_t generation; ///< 0 if allocated while tracking was disabled
+};
+
+inline int getAllocBin( size_t n )
+{
+	int b = 0;
+	while( b < g_alloc_nb_bins-1 && (size_t(1)<<b) < n )
+		b++;
+	return b;
+}
+
+inline void* trackedAlloc( size_t n ) noexcept
+{
+	AllocHeader* h = nullptr;
+	while( !(h = static_cast<AllocHeader*>( std::malloc( sizeof(AllocHeader) + n ) ) ) )
+	{
+		std::new_handler handler = std::get_new_handler();
+		if( !handler )
+			return nullptr;
+		handler();
+	}
+	h->size = n;
+	h->generation = 0;
+
+	AllocCounters& ac = getAllocCounters();
+	if( ac.enabled.load( std::memory_order_relaxed ) )
+	{
+		h->generation = ac.generation.load( std::memory_order_relaxed );
+		ac.nbAlloc.fetch_add( 1, std::memory_order_relaxed );
+		ac.bytes.fetch_add( n, std::memory_order_relaxed );
+		ac.histo[getAllocBin(n)].fetch_add( 1, std::memory_order_relaxed );
+		size_t live = ac.live.fetch_add( n, std::memory_order_relaxed ) + n;
+		size_t peak = ac.peakLive.load( std::memory_order_relaxed );
+		while( live > peak && !ac.peakLive.compare_exchange_weak( peak, live, std::memory_order_relaxed ) )
+		{}
+	}
+	return h + 1;
+}
+
+inline void trackedFree( void* p ) noexcept
+{
+	if( !p )
+		return;
+	AllocHeader* h = static_cast<AllocHeader*>( p ) - 1;
+
+	AllocCounters& ac = getAllocCounters();
+	if( ac.enabled.load( std::memory_order_relaxed ) )
+	{
+		ac.nbFree.fetch_add( 1, std::memory_order_relaxed );
+		if( h->generation == ac.generation.load( std::memory_order_relaxed ) ) // only blocks allocated during this phase
+			ac.live.fetch_sub( h->size, std::memory_order_relaxed );
+	}
+	std::free( h );
+}
+
+void* operator new( size_t n )
+{
+	void* p = trackedAlloc( n );
+	if( !p )
+		throw std::bad_alloc();
+	return p;
+}
+void* operator new[]( size_t n )
+{
+	return operator new( n );
+}
+void* operator new( size_t n, const std::nothrow_t& ) noexcept
+{
+	return trackedAlloc( n );
+}
+void* operator new[]( size_t n, const std::nothrow_t& ) noexcept
+{
+	return trackedAlloc( n );
+}
+void operator delete( void* p ) noexcept
+{
+	trackedFree( p );
+}
+void operator delete[]( void* p ) noexcept
+{
+	trackedFree( p );
+}
+void operator delete( void* p, size_t ) noexcept
+{
+	trackedFree( p );
+}
+void operator delete[]( void* p, size_t ) noexcept
+{
+	trackedFree( p );
+}
+void operator delete( void* p, const std::nothrow_t& ) noexcept
+{
+	trackedFree( p );
+}
+void operator delete[]( void* p, const std::nothrow_t& ) noexcept
+{
+	trackedFree( p );
+}
+
+#endif // NO_ALLOC_TRACKING
+
+/// Tracks the heap allocations between its creation and the call to \c PrintStats() (or \c stop())
+struct AllocTracker
+{
+	size_t _nbAlloc  = 0;
+	size_t _nbFree   = 0;
+	size_t _bytes    = 0;
+	size_t _peakLive = 0;
+	size_t _histo[g_alloc_nb_bins] = {};
+
+	AllocTracker()
+	{
+		start();
+	}
+	~AllocTracker()
+	{
+		getAllocCounters().enabled = false;
+	}
+
+	void start()
+	{
+		AllocCounters& ac = getAllocCounters();
+		ac.enabled = false;
+		ac.reset();
+		ac.generation++;
+		ac.enabled = true;
+	}
+	void stop()
+	{
+		AllocCounters& ac = getAllocCounters();
+		ac.enabled = false;
+		_nbAlloc  = ac.nbAlloc;
+		_nbFree   = ac.nbFree;
+		_bytes    = ac.bytes;
+		_peakLive = ac.peakLive;
+		for( int i=0; i<g_alloc_nb_bins; i++ )
+			_histo[i] = ac.histo[i];
+	}
+
+/// Stops, prints the stats, and restarts (same behavior as \c Timing::PrintDuration())
+	void PrintStats()
+	{
+		stop();
+#ifndef NO_ALLOC_TRACKING
+		std::cout << "Allocs: nb=" << _nbAlloc
+			<< " freed=" << _nbFree
+			<< " bytes=" << _bytes
+			<< " peak live=" << _peakLive
+			<< " sizes:";
+		for( int i=0; i<g_alloc_nb_bins; i++ )
+			if( _histo[i] )
+				std::cout << " <=" << (size_t(1)<<i) << ':' << _histo[i];
+		std::cout << '\n';
+#endif
+		start();
+	}
+};
+
+#endif // ALLOC_TRACKING_HPP
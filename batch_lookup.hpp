@@ -0,0 +1,154 @@
+/**
+\file batch_lookup.hpp
+\brief Lookups of a batch of positions, with the results written without branches: hit bitmap or selection vector
+
+The search loops of the test programs do <code>if( !mat.isNull(r,c) ) nb++;</code>: with random hits and misses,
+this branch is mispredicted about half of the time, and the answers are lost. Here the result of each lookup
+is used as a value, not as a condition:
+- \c lookupCount(): <code>nb += !isNull</code>
+- \c lookupToBitmap(): bit i of the output is set if probe i is found, built 64 probes at a time in a register
+- \c lookupToSelection(): indices of the probes found, written unconditionally, the write position advancing only on a hit
+
+The bitmaps can then be combined (\c andBitmaps() ), counted with popcount (\c popcountBitmap() ),
+or enumerated (\c forEachSetBit() ).
+
+To be fully branchless, the lookup itself must be: \c isNullCscBranchless() is a binary search whose loop
+only depends on the column length (the compiler uses conditional moves).
+*/
+
+#ifndef BATCH_LOOKUP_HPP
+#define BATCH_LOOKUP_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+/// Nb of bits set
+inline int popcount64( uint64_t x )
+{
+#if defined(__GNUC__) && defined(__POPCNT__) // else __builtin_popcountll() is a call to libgcc, slower than this
+	return __builtin_popcountll( x );
+#else
+	x = x - ( ( x >> 1 ) & 0x5555555555555555ULL );
+	x = ( x & 0x3333333333333333ULL ) + ( ( x >> 2 ) & 0x3333333333333333ULL );
+	x = ( x + ( x >> 4 ) ) & 0x0f0f0f0f0f0f0f0fULL;
+	return static_cast<int>( ( x * 0x0101010101010101ULL ) >> 56 );
+#endif
+}
+
+/// Index of the lowest bit set (\c x must not be 0)
+inline int lowestBit64( uint64_t x )
+{
+#ifdef __GNUC__
+	return __builtin_ctzll( x );
+#else
+	int n = 0;
+	while( !( x & 1 ) )
+	{
+		x >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/// Return true if element at \c row, \c col is empty: binary search without data-dependent branches
+template<typename T>
+bool isNullCscBranchless( const Eigen::SparseMatrix<T>& mat, int row, int col )
+{
+	assert( mat.isCompressed() );
+	const auto* base = mat.innerIndexPtr() + mat.outerIndexPtr()[col];
+	auto len = mat.outerIndexPtr()[col+1] - mat.outerIndexPtr()[col];
+	if( len == 0 )
+		return true;
+	while( len > 1 )
+	{
+		auto half = len / 2;
+		base = base[half] <= row ? base + half : base;
+		len -= half;
+	}
+	return *base != row;
+}
+
+/// Nb of probes found, without branch on the result
+template<typename Func>
+size_t
+lookupCount( Func isNullFunc, const std::vector<std::pair<int,int>>& probes )
+{
+	size_t nb = 0;
+	for( const auto& p: probes )
+		nb += !isNullFunc( p.first, p.second );
+	return nb;
+}
+
+/// Sets bit i of \c bits if probe i is found. \c bits is resized to the nb of probes (rounded to 64)
+template<typename Func>
+void
+lookupToBitmap( Func isNullFunc, const std::vector<std::pair<int,int>>& probes, std::vector<uint64_t>& bits )
+{
+	size_t n = probes.size();
+	bits.resize( ( n + 63 ) / 64 );
+	for( size_t w=0; w<n/64; w++ )
+	{
+		uint64_t word = 0;
+		const auto* p = probes.data() + w*64;
+		for( int j=0; j<64; j++ )
+			word |= static_cast<uint64_t>( !isNullFunc( p[j].first, p[j].second ) ) << j;
+		bits[w] = word;
+	}
+	if( n % 64 )
+	{
+		uint64_t word = 0;
+		for( size_t i=n/64*64; i<n; i++ )
+			word |= static_cast<uint64_t>( !isNullFunc( probes[i].first, probes[i].second ) ) << ( i % 64 );
+		bits[n/64] = word;
+	}
+}
+
+/// Writes in \c sel the indices of the probes found, and returns their nb. \c sel is resized to this nb
+template<typename Func>
+size_t
+lookupToSelection( Func isNullFunc, const std::vector<std::pair<int,int>>& probes, std::vector<uint32_t>& sel )
+{
+	sel.resize( probes.size() + 1 ); // the last index is always written, even if not found
+	size_t k = 0;
+	for( size_t i=0; i<probes.size(); i++ )
+	{
+		sel[k] = static_cast<uint32_t>( i );
+		k += !isNullFunc( probes[i].first, probes[i].second );
+	}
+	sel.resize( k );
+	return k;
+}
+
+/// Nb of bits set in \c bits
+inline size_t
+popcountBitmap( const std::vector<uint64_t>& bits )
+{
+	size_t nb = 0;
+	for( auto w: bits )
+		nb += popcount64( w );
+	return nb;
+}
+
+/// \c a &= \c b (for example: probes found in two matrices). Both must have the same size
+inline void
+andBitmaps( std::vector<uint64_t>& a, const std::vector<uint64_t>& b )
+{
+	assert( a.size() == b.size() );
+	for( size_t i=0; i<a.size(); i++ )
+		a[i] &= b[i];
+}
+
+/// Calls \c f(i) for each bit i set in \c bits
+template<typename Func>
+void
+forEachSetBit( const std::vector<uint64_t>& bits, Func f )
+{
+	for( size_t w=0; w<bits.size(); w++ )
+		for( uint64_t word = bits[w]; word; word &= word - 1 )
+			f( w*64 + lowestBit64( word ) );
+}
+
+#endif // BATCH_LOOKUP_HPP
@@ -0,0 +1,113 @@
+/**
+\file bench_common.hpp
+\brief Helpers shared by the test programs: random values and probes, timed probe loop, and the reference wrapper
+
+Each test program is a single translation unit, so the globals here are \c static.
+*/
+
+#ifndef BENCH_COMMON_HPP
+#define BENCH_COMMON_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <set>
+#include <cstdlib>
+#include <cstdint>
+#include "timing.hpp"
+
+/// sum of all values found, so that the compiler does not remove the searches whose result is not used
+static volatile size_t g_nbFound = 0;
+
+/// Random row or column index in a matrix of size \c matDim (not \c matDim itself, as \c rand() can return \c RAND_MAX)
+inline int
+randomIndex( size_t matDim )
+{
+	return 1.0*rand()/RAND_MAX * (matDim-1);
+}
+
+/// Allocate the data that will be stored randomly in matrix, the value of each element is given by \c makeValue()
+template<typename MakeValue>
+auto
+createTriplets( size_t matDim, size_t nbValues, MakeValue makeValue ) -> std::vector<Eigen::Triplet<decltype( makeValue() )>>
+{
+	typedef decltype( makeValue() ) T;
+	std::vector<Eigen::Triplet<T>> tripletList;
+	tripletList.reserve( nbValues );
+
+	for( size_t i=0; i<nbValues; i++ )
+	{
+		T object = makeValue();
+		int r = randomIndex( matDim ); // insert somewhere
+		int c = randomIndex( matDim );
+
+		tripletList.push_back( Eigen::Triplet<T>( r, c, object ) );
+	}
+	return tripletList;
+}
+
+/// Same, for the tests where the values are not used
+inline std::vector<Eigen::Triplet<float>>
+createTriplets( size_t matDim, size_t nbValues )
+{
+	return createTriplets( matDim, nbValues, [](){ return 1.f; } );
+}
+
+/// Random positions to search for, generated before the measure so that \c rand() is not timed
+inline std::vector<std::pair<int,int>>
+createProbes( size_t matDim, size_t nbSearches )
+{
+	std::vector<std::pair<int,int>> probes( nbSearches );
+	for( auto& p: probes )
+	{
+		p.first  = randomIndex( matDim );
+		p.second = randomIndex( matDim );
+	}
+	return probes;
+}
+
+/// Returns the mean duration of a probe, in ns. \c isNullFunc is called on each probe, \c nb is the nb of values found
+template<typename Func>
+double
+measureProbes( Func isNullFunc, const std::vector<std::pair<int,int>>& probes, size_t& nb )
+{
+	nb = 0;
+	Timing timing;
+	for( const auto& p: probes )
+		if( !isNullFunc( p.first, p.second ) )
+			nb++;
+	double t = 1.0 * timing.getDurationNs() / probes.size();
+	g_nbFound = g_nbFound + nb;
+	return t;
+}
+
+/// a wrapper over Eigen Sparse Matrix, adds a std::set of linearized positions where the non-null values are
+template<typename T>
+struct EigenSMWrapper
+{
+	std::set<int64_t>      _idx_set;
+	Eigen::SparseMatrix<T> _data;
+
+	EigenSMWrapper( int r, int c ): _data(r,c)
+	{}
+
+	bool isNull( int r, int c ) const
+	{
+		int64_t idx = static_cast<int64_t>(r) * _data.cols() + c;
+		return _idx_set.find( idx ) == _idx_set.cend();
+	}
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie )
+	{
+		_data.setFromTriplets( ib, ie );
+		_idx_set.clear();
+		for( auto it = ib;it != ie; ++it )
+			_idx_set.insert( static_cast<int64_t>( it->row() ) * _data.cols() + it->col() );
+	}
+/// Estimation for the set: 3 pointers + color per node
+	size_t setBytes() const
+	{
+		return _idx_set.size() * ( sizeof(int64_t) + 4*sizeof(void*) );
+	}
+};
+
+#endif // BENCH_COMMON_HPP
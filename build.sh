@@ -1,4 +1,18 @@
 #!/bin/bash
 
 g++ -std=c++11 eigen_test.cpp -o eigen_test
+g++ -std=c++11 eigen_test_5.cpp -o eigen_test_5
+g++ -std=c++11 eigen_test_6.cpp -o eigen_test_6
+g++ -std=c++14 -pthread eigen_test_7.cpp -o eigen_test_7
+g++ -std=c++17 -pthread eigen_test_8.cpp -o eigen_test_8
+g++ -std=c++11 eigen_test_9.cpp -o eigen_test_9
+g++ -std=c++11 -pthread eigen_test_10.cpp -o eigen_test_10
+g++ -std=c++11 -pthread eigen_test_11.cpp -o eigen_test_11
+g++ -std=c++11 eigen_test_12.cpp -o eigen_test_12
+g++ -std=c++11 -pthread eigen_test_13.cpp -o eigen_test_13
+g++ -std=c++11 -pthread eigen_test_14.cpp -o eigen_test_14
+g++ -std=c++11 -pthread eigen_test_15.cpp -o eigen_test_15
+g++ -std=c++11 eigen_test_16.cpp -o eigen_test_16
+g++ -std=c++20 -pthread eigen_test_17.cpp -o eigen_test_17
+g++ -std=c++11 -mpopcnt eigen_test_18.cpp -o eigen_test_18
 
@@ -0,0 +1,284 @@
+/**
+\file compressed_index.hpp
+\brief Compressed copy of the inner indices of a CSC matrix (delta encoding + bit-packing), removal by tombstones only
+
+In each column, rows are sorted, so instead of storing them on 4 bytes (\c innerIndexPtr() ),
+we store the differences between consecutive rows, bit-packed using the nb of bits of the largest one.
+Each column is split in blocks of \c g_cblock_size values; for each block we keep:
+- the first row (uncompressed), that is used as a skip pointer: a lookup does a binary search on these,
+then decodes a single block
+- the position of its first value in the matrix value array, so that lookups give access to the values of the Eigen matrix
+- the byte offset of its packed data, and its bit width
+
+Decoding of a block is done on 32-bit lanes: unpacking with unaligned 64-bit loads, specialized for each bit width
+(8 values are exactly \c b bytes, so all shifts are constants), then an SSE2 prefix sum (scalar fallback if SSE2 is not available).
+
+The packed data is not modified by \c erase(): the value is only marked as dead (one bit per value position, as in
+tombstone_matrix.hpp), and \c find() and \c InnerIterator skip it. As positions change when the matrix is compacted,
+the index must then be built again (which drops the tombstones).
+*/
+
+#ifndef COMPRESSED_INDEX_HPP
+#define COMPRESSED_INDEX_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
+
+/// Nb of values in a block
+constexpr int g_cblock_size = 128;
+/// Padding at the end of the packed data, as blocks are decoded by groups of 8 values
+constexpr int g_cblock_pad = 8 + 32;
+
+struct CompressedCscIndex
+{
+	size_t                _rows = 0;
+	size_t                _cols = 0;
+	std::vector<uint32_t> _colBlock;    ///< first block of each column, size cols+1
+	std::vector<uint32_t> _blockFirst;  ///< first row of each block
+	std::vector<uint32_t> _blockPos;    ///< position of the first value of each block, size nbBlocks+1
+	std::vector<uint32_t> _blockOffset; ///< offset of the packed deltas in \c _bytes
+	std::vector<uint8_t>  _blockBits;   ///< bit width of the deltas of each block
+	std::vector<uint8_t>  _bytes;       ///< packed deltas (minus one, as rows are unique), with \c g_cblock_pad bytes of padding at the end
+	std::vector<uint64_t> _dead;        ///< one bit per value position, empty if there is no dead value
+	size_t                _nbDead = 0;
+
+/// Builds the index from a compressed Eigen matrix
+	template<typename T>
+	void build( const Eigen::SparseMatrix<T>& mat )
+	{
+		assert( mat.isCompressed() );
+		_rows = mat.rows();
+		_cols = mat.cols();
+		_colBlock.assign( 1, 0 );
+		_blockFirst.clear();
+		_blockPos.clear();
+		_blockOffset.clear();
+		_blockBits.clear();
+		_bytes.clear();
+		_dead.clear();
+		_nbDead = 0;
+
+		const auto* outer = mat.outerIndexPtr();
+		const auto* inner = mat.innerIndexPtr();
+		uint64_t nbBits = 0;
+		for( size_t c=0; c<_cols; c++ )
+		{
+			for( auto pos = outer[c]; pos < outer[c+1]; pos += g_cblock_size )
+			{
+				auto end = std::min( pos + g_cblock_size, outer[c+1] );
+				uint32_t maxDelta = 0;
+				for( auto i = pos+1; i < end; i++ )
+					maxDelta = std::max( maxDelta, static_cast<uint32_t>( inner[i] - inner[i-1] - 1 ) );
+				uint8_t b = 0;
+				while( b < 32 && ( maxDelta >> b ) )
+					b++;
+
+				_blockFirst.push_back( inner[pos] );
+				_blockPos.push_back( pos );
+				_blockOffset.push_back( static_cast<uint32_t>( nbBits / 8 ) );
+				_blockBits.push_back( b );
+				assert( nbBits / 8 < UINT32_MAX );
+
+				_bytes.resize( ( nbBits + b * ( end - pos ) ) / 8 + 8, 0 );
+				uint64_t bitPos = nbBits;
+				for( auto i = pos+1; i < end; i++, bitPos += b )
+				{
+					uint64_t d = static_cast<uint32_t>( inner[i] - inner[i-1] - 1 );
+					uint64_t w;
+					std::memcpy( &w, &_bytes[bitPos>>3], 8 );
+					w |= d << (bitPos&7);
+					std::memcpy( &_bytes[bitPos>>3], &w, 8 );
+				}
+				nbBits = ( bitPos + 7 ) & ~uint64_t(7); // each block starts on a byte
+			}
+			_colBlock.push_back( _blockFirst.size() );
+		}
+		_blockPos.push_back( mat.nonZeros() );
+		_bytes.resize( nbBits / 8 + g_cblock_pad, 0 );
+		_bytes.shrink_to_fit();
+	}
+
+/// Nb of values not erased
+	size_t nonZeros() const
+	{
+		return ( _blockPos.empty() ? 0 : _blockPos.back() ) - _nbDead;
+	}
+
+/// Memory used (with the tombstones), in bytes
+	size_t memoryBytes() const
+	{
+		return ( _colBlock.capacity() + _blockFirst.capacity() + _blockPos.capacity() + _blockOffset.capacity() ) * sizeof(uint32_t)
+			+ _blockBits.capacity() + _bytes.capacity() + _dead.capacity() * sizeof(uint64_t);
+	}
+
+/// Returns true if the value at position \c pos has been erased
+	bool isDead( size_t pos ) const
+	{
+		return _nbDead && ( ( _dead[pos>>6] >> (pos&63) ) & 1 );
+	}
+
+/// Nb of values in block \c k
+	int blockSize( size_t k ) const
+	{
+		return _blockPos[k+1] - _blockPos[k];
+	}
+
+/// Decodes the rows of block \c k into \c rows (that must hold \c g_cblock_size+8 values), returns the nb of values
+	int decodeBlock( size_t k, uint32_t* rows ) const
+	{
+		typedef void (*UnpackFunc)( const uint8_t*, uint32_t*, int );
+		static const UnpackFunc unpackFuncs[33] = {
+			&unpack<0>,  &unpack<1>,  &unpack<2>,  &unpack<3>,  &unpack<4>,  &unpack<5>,  &unpack<6>,  &unpack<7>,
+			&unpack<8>,  &unpack<9>,  &unpack<10>, &unpack<11>, &unpack<12>, &unpack<13>, &unpack<14>, &unpack<15>,
+			&unpack<16>, &unpack<17>, &unpack<18>, &unpack<19>, &unpack<20>, &unpack<21>, &unpack<22>, &unpack<23>,
+			&unpack<24>, &unpack<25>, &unpack<26>, &unpack<27>, &unpack<28>, &unpack<29>, &unpack<30>, &unpack<31>,
+			&unpack<32>
+		};
+		int n = blockSize( k );
+		rows[0] = _blockFirst[k];
+		unpackFuncs[_blockBits[k]]( _bytes.data() + _blockOffset[k], rows+1, n-1 );
+		prefixSum( rows, n );
+		return n;
+	}
+
+/// Position of element (r,c) in the value array of the matrix, or -1 if not present (or erased)
+	std::ptrdiff_t find( int r, int c ) const
+	{
+		std::ptrdiff_t pos = findPacked( r, c );
+		return pos < 0 || isDead( pos ) ? -1 : pos;
+	}
+
+/// Removes element (r,c) from the index, once it has been erased in the matrix. Returns false if it was already empty
+	bool erase( int r, int c )
+	{
+		std::ptrdiff_t pos = find( r, c );
+		if( pos < 0 )
+			return false;
+		if( _dead.empty() )
+			_dead.assign( ( _blockPos.back() + 63 ) / 64, 0 );
+		_dead[pos>>6] |= uint64_t(1) << (pos&63);
+		_nbDead++;
+		return true;
+	}
+
+/// Position of element (r,c) in the packed data, without checking the tombstones
+	std::ptrdiff_t findPacked( int r, int c ) const
+	{
+		const uint32_t* first = _blockFirst.data() + _colBlock[c];
+		const uint32_t* last  = _blockFirst.data() + _colBlock[c+1];
+		const uint32_t* it = std::upper_bound( first, last, static_cast<uint32_t>(r) ); // skip pointers
+		if( it == first )
+			return -1;
+		size_t k = it - _blockFirst.data() - 1;
+		if( _blockFirst[k] == static_cast<uint32_t>(r) )
+			return _blockPos[k];
+
+		uint32_t rows[g_cblock_size+8];
+		int n = decodeBlock( k, rows );
+		int i = 0;
+		for( int j=0; j<n; j++ ) // no early exit: counts the smaller rows, so that it can be vectorized
+			i += rows[j] < static_cast<uint32_t>(r);
+		if( i == n || rows[i] != static_cast<uint32_t>(r) )
+			return -1;
+		return _blockPos[k] + i;
+	}
+
+/// Return true if element at \c row, \c col is empty
+	bool isNull( int r, int c ) const
+	{
+		return find( r, c ) < 0;
+	}
+
+/// Iterates over the rows of column \c c, decoding one block at a time
+	class InnerIterator
+	{
+		const CompressedCscIndex& _idx;
+		size_t   _block;
+		size_t   _endBlock;
+		int      _i = 0;
+		int      _n = 0;
+		int      _col;
+		uint32_t _rows[g_cblock_size+8];
+
+		void load()
+		{
+			_i = 0;
+			_n = _block < _endBlock ? _idx.decodeBlock( _block, _rows ) : 0;
+		}
+		void next()
+		{
+			if( ++_i == _n )
+			{
+				_block++;
+				load();
+			}
+		}
+		void skipDead()
+		{
+			while( _i < _n && _idx.isDead( index() ) )
+				next();
+		}
+	public:
+		InnerIterator( const CompressedCscIndex& idx, int c )
+			: _idx(idx), _block(idx._colBlock[c]), _endBlock(idx._colBlock[c+1]), _col(c)
+		{
+			load();
+			skipDead();
+		}
+		InnerIterator& operator ++ ()
+		{
+			next();
+			skipDead();
+			return *this;
+		}
+		operator bool() const { return _i < _n; }
+		int    row()   const { return _rows[_i]; }
+		int    col()   const { return _col; }
+/// position in the value array of the matrix
+		size_t index() const { return _idx._blockPos[_block] + _i; }
+	};
+
+private:
+/// Unpacks \c n deltas of \c B bits (plus one), by groups of 8 values (may write up to 7 values after \c n)
+	template<int B>
+	static void unpack( const uint8_t* p, uint32_t* out, int n )
+	{
+		const uint64_t mask = ( uint64_t(1) << B ) - 1;
+		for( int g=0; g<n; g += 8, p += B, out += 8 )
+			for( int j=0; j<8; j++ )
+			{
+				uint64_t w;
+				std::memcpy( &w, p + j*B/8, 8 );
+				out[j] = static_cast<uint32_t>( ( w >> (j*B%8) ) & mask ) + 1;
+			}
+	}
+
+/// In-place inclusive prefix sum
+	static void prefixSum( uint32_t* v, int n )
+	{
+		int i = 0;
+#ifdef __SSE2__
+		__m128i carry = _mm_setzero_si128();
+		for( ; i+4 <= n; i += 4 )
+		{
+			__m128i x = _mm_loadu_si128( reinterpret_cast<const __m128i*>( v+i ) );
+			x = _mm_add_epi32( x, _mm_slli_si128( x, 4 ) );
+			x = _mm_add_epi32( x, _mm_slli_si128( x, 8 ) );
+			x = _mm_add_epi32( x, carry );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( v+i ), x );
+			carry = _mm_shuffle_epi32( x, 0xFF );
+		}
+#endif
+		for( i = std::max( i, 1 ); i < n; i++ )
+			v[i] += v[i-1];
+	}
+};
+
+#endif // COMPRESSED_INDEX_HPP
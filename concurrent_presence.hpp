@@ -0,0 +1,305 @@
+/**
+\file concurrent_presence.hpp
+\brief Presence indexes that can be filled by several threads at the same time (and read while filled)
+
+- \c ShardedPresence : the positions are spread by hash over \c NbShards hash sets, each with its own lock
+- \c LockFreePresence : a single open-addressing table (linear probing), insertion is a CAS on an empty slot.
+Capacity is fixed at construction (no rehash). A removed position leaves a tombstone in its slot, that is
+not reused before \c clear(), so the capacity must include the removed values.
+
+Both use the same linearized 64 bits positions as presence_index.hpp.
+
+\c ConcurrentSMWrapper uses one of these so that \c insertElem() can be called from several threads,
+and fills it with several threads in \c setFromTriplets().
+*/
+
+#ifndef CONCURRENT_PRESENCE_HPP
+#define CONCURRENT_PRESENCE_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+#include <exception>
+#include "hash_util.hpp"
+
+//-----------------------------------------------------------------------------------
+/// Hash sets protected by one lock per shard
+template<int NbShards=64>
+struct ShardedPresence
+{
+	static_assert( ( NbShards & (NbShards-1) ) == 0, "NbShards must be a power of 2" );
+
+	struct alignas(64) Shard
+	{
+		std::mutex                  _mutex;
+		std::unordered_set<int64_t> _idx_set;
+	};
+
+	std::unique_ptr<Shard[]> _shards;
+	size_t                   _cols;
+
+	ShardedPresence( size_t /*rows*/, size_t cols, size_t nnz=0 ): _shards( new Shard[NbShards] ), _cols(cols)
+	{
+		for( int i=0; i<NbShards; i++ )
+			_shards[i]._idx_set.reserve( nnz / NbShards );
+	}
+
+/// Returns false if already present
+	bool insert( int r, int c )
+	{
+		int64_t k = static_cast<int64_t>(r) * _cols + c;
+		Shard& s = _shards[ hashPosition(k) & (NbShards-1) ];
+		std::lock_guard<std::mutex> lock( s._mutex );
+		return s._idx_set.insert( k ).second;
+	}
+/// Returns false if not present
+	bool erase( int r, int c )
+	{
+		int64_t k = static_cast<int64_t>(r) * _cols + c;
+		Shard& s = _shards[ hashPosition(k) & (NbShards-1) ];
+		std::lock_guard<std::mutex> lock( s._mutex );
+		return s._idx_set.erase( k ) != 0;
+	}
+	bool isNull( int r, int c ) const
+	{
+		int64_t k = static_cast<int64_t>(r) * _cols + c;
+		Shard& s = _shards[ hashPosition(k) & (NbShards-1) ];
+		std::lock_guard<std::mutex> lock( s._mutex );
+		return s._idx_set.find( k ) == s._idx_set.cend();
+	}
+/// Removes all the positions (not thread-safe)
+	void clear()
+	{
+		for( int i=0; i<NbShards; i++ )
+			_shards[i]._idx_set.clear();
+	}
+	size_t size() const
+	{
+		size_t n = 0;
+		for( int i=0; i<NbShards; i++ )
+		{
+			std::lock_guard<std::mutex> lock( _shards[i]._mutex );
+			n += _shards[i]._idx_set.size();
+		}
+		return n;
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// Open addressing hash table, lock-free insertion and lookup
+/**
+A slot holds the position plus one, so that 0 means "empty", and \c g_tombstone once the position is removed.
+A slot only goes from empty to a position, then to a tombstone, so readers only need acquire loads.
+Tombstones are not reused (a reused slot could let two threads insert the same position in two slots).
+*/
+struct LockFreePresence
+{
+	std::unique_ptr<std::atomic<uint64_t>[]> _slots;
+	size_t                                   _mask;
+	size_t                                   _cols;
+	std::atomic<size_t>                      _size;
+
+	static constexpr uint64_t g_tombstone = UINT64_MAX;
+
+/// \c nnz is the max nb of values that will be inserted (the table gets twice this size)
+	LockFreePresence( size_t /*rows*/, size_t cols, size_t nnz ): _cols(cols), _size(0)
+	{
+		size_t capacity = 16;
+		while( capacity < 2*nnz )
+			capacity *= 2;
+		_slots.reset( new std::atomic<uint64_t>[capacity] );
+		for( size_t i=0; i<capacity; i++ )
+			_slots[i].store( 0, std::memory_order_relaxed );
+		_mask = capacity - 1;
+	}
+
+/// Returns false if already present, throws if the table is full
+	bool insert( int r, int c )
+	{
+		uint64_t k = static_cast<uint64_t>( static_cast<int64_t>(r) * _cols + c ) + 1;
+		size_t i = hashPosition(k) & _mask;
+		for( size_t n=0; n<=_mask; n++, i = (i+1) & _mask )
+		{
+			uint64_t cur = _slots[i].load( std::memory_order_acquire );
+			if( cur == k )
+				return false;
+			if( cur == 0 )
+			{
+				if( _slots[i].compare_exchange_strong( cur, k, std::memory_order_acq_rel ) )
+				{
+					_size.fetch_add( 1, std::memory_order_relaxed );
+					return true;
+				}
+				if( cur == k ) // another thread inserted the same position
+					return false;
+			}
+		}
+		throw std::runtime_error( "LockFreePresence: table is full" );
+	}
+/// Returns false if not present (or removed by another thread at the same time)
+	bool erase( int r, int c )
+	{
+		uint64_t k = static_cast<uint64_t>( static_cast<int64_t>(r) * _cols + c ) + 1;
+		size_t i = hashPosition(k) & _mask;
+		for( size_t n=0; n<=_mask; n++, i = (i+1) & _mask )
+		{
+			uint64_t cur = _slots[i].load( std::memory_order_acquire );
+			if( cur == 0 )
+				return false;
+			if( cur == k )
+			{
+				if( !_slots[i].compare_exchange_strong( cur, g_tombstone, std::memory_order_acq_rel ) )
+					return false;
+				_size.fetch_sub( 1, std::memory_order_relaxed );
+				return true;
+			}
+		}
+		return false;
+	}
+	bool isNull( int r, int c ) const
+	{
+		uint64_t k = static_cast<uint64_t>( static_cast<int64_t>(r) * _cols + c ) + 1;
+		size_t i = hashPosition(k) & _mask;
+		for( size_t n=0; n<=_mask; n++, i = (i+1) & _mask )
+		{
+			uint64_t cur = _slots[i].load( std::memory_order_acquire );
+			if( cur == k )
+				return false;
+			if( cur == 0 )
+				return true;
+		}
+		return true;
+	}
+/// Removes all the positions (not thread-safe)
+	void clear()
+	{
+		for( size_t i=0; i<=_mask; i++ )
+			_slots[i].store( 0, std::memory_order_relaxed );
+		_size.store( 0 );
+	}
+	size_t size() const
+	{
+		return _size.load();
+	}
+	size_t memoryBytes() const
+	{
+		return ( _mask + 1 ) * sizeof(uint64_t);
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// a wrapper over Eigen Sparse Matrix, with a presence index that can be filled by several threads
+/**
+The Eigen matrix itself can not be modified concurrently, so \c insertElem() updates the presence index
+immediately and stores the value in a per-shard buffer, that is moved to the matrix by \c flush()
+(to be called when no thread is inserting).
+*/
+template<typename T, typename Presence>
+struct ConcurrentSMWrapper
+{
+	struct alignas(64) Pending
+	{
+		std::mutex                        _mutex;
+		std::vector<Eigen::Triplet<T>>    _triplets;
+	};
+	static constexpr int g_nb_pending = 16;
+
+	Eigen::SparseMatrix<T>     _data;
+	Presence                   _presence;
+	std::unique_ptr<Pending[]> _pending;
+
+/// \c nnz is the max nb of values (needed by \c LockFreePresence)
+	ConcurrentSMWrapper( int r, int c, size_t nnz ): _data(r,c), _presence(r,c,nnz), _pending( new Pending[g_nb_pending] )
+	{}
+
+	bool isNull( int r, int c ) const
+	{
+		return _presence.isNull( r, c );
+	}
+
+/// Thread-safe. Value is ignored if there is already one at that position
+	void insertElem( int r, int c, const T& t )
+	{
+		if( !_presence.insert( r, c ) )
+			return;
+		Pending& p = _pending[ std::hash<std::thread::id>()( std::this_thread::get_id() ) % g_nb_pending ];
+		std::lock_guard<std::mutex> lock( p._mutex );
+		p._triplets.push_back( Eigen::Triplet<T>( r, c, t ) );
+	}
+
+/// Moves the values inserted by \c insertElem() to the matrix (not thread-safe)
+	void flush()
+	{
+		std::vector<Eigen::Triplet<T>> triplets;
+		triplets.reserve( _data.nonZeros() );
+		for( int k=0; k<_data.outerSize(); ++k )
+			for( typename Eigen::SparseMatrix<T>::InnerIterator it(_data,k); it; ++it )
+				triplets.push_back( Eigen::Triplet<T>( it.row(), it.col(), it.value() ) );
+		for( int i=0; i<g_nb_pending; i++ )
+		{
+			triplets.insert( triplets.end(), _pending[i]._triplets.begin(), _pending[i]._triplets.end() );
+			_pending[i]._triplets.clear();
+		}
+		_data.setFromTriplets( triplets.begin(), triplets.end() );
+	}
+
+/// Fills the matrix on the calling thread while \c nbThreads other threads fill the presence index.
+/// As with Eigen, the previous content is replaced: the presence index and the pending values are cleared.
+/// If \c nbThreads < 1, the presence index is filled on the calling thread. An exception thrown by a thread
+/// (for example a full \c LockFreePresence) is rethrown here, once all the threads are joined
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie, int nbThreads )
+	{
+		_presence.clear();
+		for( int i=0; i<g_nb_pending; i++ )
+			_pending[i]._triplets.clear();
+		if( nbThreads < 1 )
+		{
+			_data.setFromTriplets( ib, ie );
+			for( auto it = ib; it != ie; ++it )
+				_presence.insert( it->row(), it->col() );
+			return;
+		}
+		size_t nb = std::distance( ib, ie );
+		std::vector<std::exception_ptr> errors( nbThreads + 1 ); // the last one for the calling thread
+		std::vector<std::thread> threads;
+		for( int t=0; t<nbThreads; t++ )
+			threads.push_back( std::thread( [this,ib,nb,t,nbThreads,&errors]()
+			{
+				try
+				{
+					auto it = ib;
+					std::advance( it, nb * t / nbThreads );
+					auto end = ib;
+					std::advance( end, nb * (t+1) / nbThreads );
+					for( ; it != end; ++it )
+						_presence.insert( it->row(), it->col() );
+				}
+				catch( ... )
+				{
+					errors[t] = std::current_exception();
+				}
+			} ) );
+		try
+		{
+			_data.setFromTriplets( ib, ie );
+		}
+		catch( ... )
+		{
+			errors[nbThreads] = std::current_exception();
+		}
+		for( auto& th: threads )
+			th.join();
+		for( const auto& e: errors )
+			if( e )
+				std::rethrow_exception( e );
+	}
+};
+
+#endif // CONCURRENT_PRESENCE_HPP
@@ -0,0 +1,312 @@
+/**
+\file coro_lookup.hpp
+\brief Interleaved lookups with C++20 coroutines: each lookup prefetches the next memory location it needs, and suspends
+
+When the matrix is much larger than the last level cache, each step of a lookup (outer index, then each step of the
+binary search in the inner index, or the hash slot) is a cache miss, and the thread waits for DRAM.
+Here each lookup is a coroutine that, before each of these accesses, issues a prefetch and suspends.
+\c runInterleaved() keeps \c groupSize lookups in flight and resumes them in turn, so that while one waits
+for its data, the others proceed, and the memory accesses of the group overlap.
+
+Coroutine frames are allocated from a per-thread free list (\c CoroFramePool), as a heap allocation per lookup
+would cost about as much as the time saved.
+
+The lookups provided:
+- \c isNullCscCoro(): Eigen CSC matrix, branchless binary search (same as \c isNullCscBranchless(), see batch_lookup.hpp)
+- \c isNullHashCoro(): open-addressing hash (\c ShapedHash, see fixed_shape.hpp)
+- \c isNullEytzingerCoro(): ordered set of the linearized positions, as the \c std::set of \c EigenSMWrapper, but stored
+as an implicit tree in an array (\c EytzingerSet), prefetch + suspend at each node hop. Pointer-based trees are the usual
+case for this, but \c std::set does not give access to its nodes, so the coroutine could not prefetch the child before
+going down.
+
+Requires C++20.
+*/
+
+#ifndef CORO_LOOKUP_HPP
+#define CORO_LOOKUP_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <coroutine>
+#include <vector>
+#include <new>
+#include <exception>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include "fixed_shape.hpp"
+#include "batch_lookup.hpp"
+
+//-----------------------------------------------------------------------------------
+/// Per-thread free list of coroutine frames (all the frames of a given lookup have the same size)
+struct CoroFramePool
+{
+	static constexpr size_t BlockSize = 256; ///< larger frames use the default allocator
+
+	struct FreeList
+	{
+		void* head = nullptr;
+		~FreeList()
+		{
+			while( head )
+			{
+				void* next = *static_cast<void**>( head );
+				::operator delete( head );
+				head = next;
+			}
+		}
+	};
+	static FreeList& freeList()
+	{
+		thread_local FreeList fl;
+		return fl;
+	}
+	static void* allocate( size_t n )
+	{
+		if( n > BlockSize )
+			return ::operator new( n );
+		auto& fl = freeList();
+		if( !fl.head )
+			return ::operator new( BlockSize );
+		void* p = fl.head;
+		fl.head = *static_cast<void**>( p );
+		return p;
+	}
+	static void deallocate( void* p, size_t n )
+	{
+		if( n > BlockSize )
+		{
+			::operator delete( p );
+			return;
+		}
+		auto& fl = freeList();
+		*static_cast<void**>( p ) = fl.head;
+		fl.head = p;
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// Ordered set of linearized positions (row * cols + col), stored as a binary search tree in an array
+/// (Eytzinger layout: the children of node k are nodes 2k and 2k+1, the root is node 1)
+struct EytzingerSet
+{
+	std::vector<int64_t> _keys; ///< \c _keys[0] is not used
+	int64_t              _cols = 0;
+
+/// Builds from the sorted positions [ib,ie)
+	template<typename It>
+	void build( size_t cols, It ib, It ie )
+	{
+		_cols = cols;
+		_keys.assign( std::distance( ib, ie ) + 1, 0 );
+		fill( 1, ib );
+	}
+	size_t size() const { return _keys.size() - 1; }
+	int64_t key( int r, int c ) const
+	{
+		return static_cast<int64_t>(r) * _cols + c;
+	}
+/// Node where the search of \c x ended (index of the first key >= \c x), to be called when going down to \c k is over
+	static size_t lowerBoundNode( size_t k )
+	{
+		return k >> ( lowestBit64( ~static_cast<uint64_t>( k ) ) + 1 );
+	}
+	bool isNull( int r, int c ) const
+	{
+		int64_t x = key( r, c );
+		size_t k = 1;
+		while( k <= size() )
+			k = 2*k + ( _keys[k] < x );
+		k = lowerBoundNode( k );
+		return k == 0 || _keys[k] != x;
+	}
+	size_t memoryBytes() const
+	{
+		return _keys.capacity() * sizeof(int64_t);
+	}
+
+private:
+/// In-order traversal of the tree, taking the sorted keys in turn
+	template<typename It>
+	void fill( size_t k, It& it )
+	{
+		if( k > size() )
+			return;
+		fill( 2*k, it );
+		_keys[k] = *it++;
+		fill( 2*k+1, it );
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// Coroutine returning the result of a lookup. Starts suspended, and stays suspended at the end so that the result can be read
+struct LookupTask
+{
+	struct promise_type
+	{
+		bool result = true;
+
+		LookupTask get_return_object()
+		{
+			return LookupTask( std::coroutine_handle<promise_type>::from_promise( *this ) );
+		}
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_value( bool b ) { result = b; }
+		void unhandled_exception() { std::terminate(); }
+
+		static void* operator new( size_t n ) { return CoroFramePool::allocate( n ); }
+		static void operator delete( void* p, size_t n ) { CoroFramePool::deallocate( p, n ); }
+	};
+	typedef std::coroutine_handle<promise_type> Handle;
+
+	Handle _handle;
+
+	explicit LookupTask( Handle h ): _handle(h)
+	{}
+	LookupTask( LookupTask&& other ) noexcept: _handle(other._handle)
+	{
+		other._handle = nullptr;
+	}
+	LookupTask( const LookupTask& ) = delete;
+	LookupTask& operator = ( const LookupTask& ) = delete;
+	~LookupTask()
+	{
+		if( _handle )
+			_handle.destroy();
+	}
+/// Gives the ownership of the coroutine to the caller
+	Handle release()
+	{
+		Handle h = _handle;
+		_handle = nullptr;
+		return h;
+	}
+};
+
+/// Awaitable: prefetches \c p, then suspends
+struct PrefetchAndSuspend
+{
+	const void* _p;
+
+	bool await_ready() const noexcept
+	{
+		__builtin_prefetch( _p );
+		return false;
+	}
+	void await_suspend( std::coroutine_handle<> ) const noexcept {}
+	void await_resume() const noexcept {}
+};
+
+//-----------------------------------------------------------------------------------
+/// Return true if element at \c row, \c col is empty: prefetch + suspend before reading the outer index and each inner index
+template<typename T>
+LookupTask
+isNullCscCoro( const Eigen::SparseMatrix<T>& mat, int row, int col )
+{
+	const auto* outer = mat.outerIndexPtr() + col;
+	co_await PrefetchAndSuspend{ outer };
+	const auto* base = mat.innerIndexPtr() + outer[0];
+	auto len = outer[1] - outer[0];
+	if( len == 0 )
+		co_return true;
+	while( len > 1 )
+	{
+		auto half = len / 2;
+		co_await PrefetchAndSuspend{ base + half };
+		base = base[half] <= row ? base + half : base;
+		len -= half;
+	}
+	co_await PrefetchAndSuspend{ base };
+	co_return *base != row;
+}
+
+/// Return true if element at \c row, \c col is empty: prefetch + suspend before reading the first slot,
+/// and again when the linear probing goes to the next cache line
+template<typename Shape>
+LookupTask
+isNullHashCoro( const ShapedHash<Shape>& hash, int row, int col )
+{
+	typedef typename Shape::Key Key;
+	constexpr size_t slotsPerLine = 64 / sizeof(Key);
+
+	Key k = hash._shape.key( row, col ) + 1;
+	size_t i = hashPosition( k ) & hash._mask;
+	co_await PrefetchAndSuspend{ hash._slots.data() + i };
+	while( true )
+	{
+		Key cur = hash._slots[i];
+		if( cur == k )
+			co_return false;
+		if( cur == 0 )
+			co_return true;
+		i = (i+1) & hash._mask;
+		if( i % slotsPerLine == 0 )
+			co_await PrefetchAndSuspend{ hash._slots.data() + i };
+	}
+}
+
+/// Return true if element at \c row, \c col is empty: prefetch + suspend before reading each node of the tree
+inline LookupTask
+isNullEytzingerCoro( const EytzingerSet& set, int row, int col )
+{
+	int64_t x = set.key( row, col );
+	size_t n = set.size();
+	size_t k = 1;
+	while( k <= n )
+	{
+		co_await PrefetchAndSuspend{ set._keys.data() + k };
+		k = 2*k + ( set._keys[k] < x );
+	}
+	k = EytzingerSet::lowerBoundNode( k );
+	co_return k == 0 || set._keys[k] != x;
+}
+
+//-----------------------------------------------------------------------------------
+/// Runs \c nbLookups lookups, keeping \c groupSize of them in flight
+/**
+- \c makeTask(i) returns the \c LookupTask of lookup i
+- \c onResult(i,isNull) is called when lookup i is done (not in order)
+*/
+template<typename MakeTask, typename OnResult>
+void
+runInterleaved( size_t nbLookups, size_t groupSize, MakeTask makeTask, OnResult onResult )
+{
+	std::vector<LookupTask::Handle> slots( groupSize );
+	std::vector<size_t>             ids( groupSize );
+	size_t next = 0;
+	size_t active = 0;
+	for( ; active<groupSize && next<nbLookups; active++, next++ )
+	{
+		slots[active] = makeTask( next ).release();
+		ids[active] = next;
+	}
+	while( active )
+	{
+		for( size_t i=0; i<active; )
+		{
+			auto h = slots[i];
+			h.resume();
+			if( !h.done() )
+			{
+				i++;
+				continue;
+			}
+			onResult( ids[i], h.promise().result );
+			h.destroy();
+			if( next < nbLookups ) // start a new one in the same slot
+			{
+				slots[i] = makeTask( next ).release();
+				ids[i] = next++;
+				i++;
+			}
+			else // remove the slot (the last one is moved here, and resumed now)
+			{
+				active--;
+				slots[i] = slots[active];
+				ids[i] = ids[active];
+			}
+		}
+	}
+}
+
+#endif // CORO_LOOKUP_HPP
@@ -0,0 +1,265 @@
+/**
+\file dcsc_matrix.hpp
+\brief Doubly compressed sparse column (DCSC) matrix, for hypersparse matrices (nb of values << nb of columns)
+
+With standard CSC (\c Eigen::SparseMatrix), the outer index array has \c cols+1 elements, whatever the number of values.
+When most of the columns are empty, this array dominates memory and initialization time.
+Here, only the ids of non-empty columns are stored, with their offsets:
+- \c _colIds : ids of the non-empty columns (sorted), size nzc
+- \c _colPtr : offset of each of these columns in \c _rowIdx and \c _values, size nzc+1
+- \c _rowIdx, \c _values : same as CSC, size nnz
+
+Finding a column is a binary search in \c _colIds, so the matrix dimensions do not appear anywhere in memory.
+
+\c erase() only marks the value as dead (tombstone, one bit per value, as in tombstone_matrix.hpp): lookups and
+\c InnerIterator skip it. The arrays are compacted (dead values and columns left empty removed) once \c _maxDeadRatio of
+the values are dead, when \c compact() is called, or before an \c insertElem().
+
+The API follows \c Eigen::SparseMatrix (\c setFromTriplets(), \c outerSize(), \c InnerIterator) and the wrappers (\c isNull()).
+*/
+
+#ifndef DCSC_MATRIX_HPP
+#define DCSC_MATRIX_HPP
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cassert>
+
+template<typename T, typename StorageIndex=int>
+struct DcscMatrix
+{
+	size_t                    _rows;
+	size_t                    _cols;
+	std::vector<StorageIndex> _colIds;
+	std::vector<StorageIndex> _colPtr;
+	std::vector<StorageIndex> _rowIdx;
+	std::vector<T>            _values;
+	std::vector<uint64_t>     _dead;              ///< one bit per value, empty if there is no dead value
+	size_t                    _nbDead = 0;
+	double                    _maxDeadRatio = 0.25;  ///< compaction is done when this ratio of values is dead
+
+	DcscMatrix( int r, int c ): _rows(r), _cols(c), _colPtr(1,0)
+	{}
+
+	size_t rows() const { return _rows; }
+	size_t cols() const { return _cols; }
+/// Nb of values not erased
+	size_t nonZeros() const { return _rowIdx.size() - _nbDead; }
+	size_t nbDead() const { return _nbDead; }
+
+/// Nb of non-empty columns (before compaction, a column may only hold dead values)
+	size_t outerSize() const { return _colIds.size(); }
+
+/// Fills the matrix. As with Eigen, duplicate elements are summed
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie )
+	{
+		size_t nb = std::distance( ib, ie );
+
+// sort an array of positions instead of the triplets, so that values are copied only once
+		std::vector<InputIterators> order;
+		order.reserve( nb );
+		for( auto it = ib; it != ie; ++it )
+			order.push_back( it );
+		std::stable_sort(
+			order.begin(),
+			order.end(),
+			[]( const InputIterators& a, const InputIterators& b )
+			{
+				return a->col() < b->col() || ( a->col() == b->col() && a->row() < b->row() );
+			}
+		);
+
+		_colIds.clear();
+		_colPtr.assign( 1, 0 );
+		_rowIdx.clear();
+		_values.clear();
+		_dead.clear();
+		_nbDead = 0;
+		_rowIdx.reserve( nb );
+		_values.reserve( nb );
+		for( const auto& it: order )
+		{
+			assert( it->row() >= 0 && static_cast<size_t>(it->row()) < _rows );
+			assert( it->col() >= 0 && static_cast<size_t>(it->col()) < _cols );
+			if( _colIds.empty() || _colIds.back() != it->col() )
+			{
+				_colIds.push_back( it->col() );
+				_colPtr.push_back( _colPtr.back() );
+			}
+			else if( _rowIdx.back() == it->row() ) // duplicate
+			{
+				_values.back() = _values.back() + it->value();
+				continue;
+			}
+			_rowIdx.push_back( it->row() );
+			_values.push_back( it->value() );
+			_colPtr.back()++;
+		}
+		_colIds.shrink_to_fit();
+		_colPtr.shrink_to_fit();
+	}
+
+/// Inserts a single element, that must not be already present. Cost is linear in the nb of values, so use \c setFromTriplets() for bulk insertion
+	void insertElem( int r, int c, const T& t )
+	{
+		compact(); // the tombstones are positions in the arrays, that are shifted here
+		auto itc = std::lower_bound( _colIds.begin(), _colIds.end(), c );
+		size_t k = itc - _colIds.begin();
+		if( itc == _colIds.end() || *itc != c )
+		{
+			_colIds.insert( itc, c );
+			_colPtr.insert( _colPtr.begin() + k + 1, _colPtr[k] );
+		}
+		auto first = _rowIdx.begin() + _colPtr[k];
+		auto itr = std::lower_bound( first, _rowIdx.begin() + _colPtr[k+1], r );
+		assert( itr == _rowIdx.begin() + _colPtr[k+1] || *itr != r );
+		size_t pos = itr - _rowIdx.begin();
+		_rowIdx.insert( itr, r );
+		_values.insert( _values.begin() + pos, t );
+		for( size_t i=k+1; i<_colPtr.size(); i++ )
+			_colPtr[i]++;
+	}
+
+/// Index of column \c c in \c _colIds, or -1 if that column is empty
+	std::ptrdiff_t findCol( int c ) const
+	{
+		auto it = std::lower_bound( _colIds.begin(), _colIds.end(), c );
+		if( it == _colIds.end() || *it != c )
+			return -1;
+		return it - _colIds.begin();
+	}
+
+/// Returns true if the value at position \c pos in \c _values has been erased
+	bool isDead( std::ptrdiff_t pos ) const
+	{
+		return _nbDead && ( ( _dead[pos>>6] >> (pos&63) ) & 1 );
+	}
+
+/// Position of element (r,c) in \c _rowIdx and \c _values, or -1 if not present (or erased)
+	std::ptrdiff_t findElem( int r, int c ) const
+	{
+		std::ptrdiff_t k = findCol( c );
+		if( k < 0 )
+			return -1;
+		auto first = _rowIdx.begin() + _colPtr[k];
+		auto last  = _rowIdx.begin() + _colPtr[k+1];
+		auto it = std::lower_bound( first, last, r );
+		if( it == last || *it != r || isDead( it - _rowIdx.begin() ) )
+			return -1;
+		return it - _rowIdx.begin();
+	}
+
+/// Removes element (r,c). Returns false if it was already empty
+	bool erase( int r, int c )
+	{
+		std::ptrdiff_t pos = findElem( r, c );
+		if( pos < 0 )
+			return false;
+		if( _dead.empty() )
+			_dead.assign( ( _rowIdx.size() + 63 ) / 64, 0 );
+		_dead[pos>>6] |= uint64_t(1) << (pos&63);
+		_nbDead++;
+		if( _nbDead > _maxDeadRatio * _rowIdx.size() )
+			compact();
+		return true;
+	}
+
+/// Removes the dead values, and the columns left empty, from the arrays (single pass, in place), then frees the unused memory
+	void compact()
+	{
+		if( _nbDead == 0 )
+			return;
+		StorageIndex k = 0;
+		size_t nbCols = 0;
+		for( size_t j=0; j<_colIds.size(); j++ )
+		{
+			StorageIndex start = _colPtr[j];
+			StorageIndex end   = _colPtr[j+1];
+			StorageIndex first = k;
+			for( StorageIndex i=start; i<end; i++ )
+				if( !isDead( i ) )
+				{
+					if( k != i )
+					{
+						_rowIdx[k] = _rowIdx[i];
+						_values[k] = std::move( _values[i] );
+					}
+					k++;
+				}
+			if( k == first )
+				continue;
+			_colIds[nbCols] = _colIds[j];
+			_colPtr[nbCols] = first;
+			nbCols++;
+		}
+		_colIds.resize( nbCols );
+		_colPtr.resize( nbCols + 1 );
+		_colPtr[nbCols] = k;
+		_rowIdx.resize( k );
+		_values.resize( k );
+		_colIds.shrink_to_fit();
+		_colPtr.shrink_to_fit();
+		_rowIdx.shrink_to_fit();
+		_values.shrink_to_fit();
+		_dead.clear();
+		_dead.shrink_to_fit();
+		_nbDead = 0;
+	}
+
+/// Return true if element at \c row, \c col is empty
+	bool isNull( int r, int c ) const
+	{
+		return findElem( r, c ) < 0;
+	}
+
+/// Returns the value at (r,c), or a default one if empty (same as \c Eigen::SparseMatrix::coeff() )
+	T coeff( int r, int c ) const
+	{
+		std::ptrdiff_t pos = findElem( r, c );
+		return pos < 0 ? T() : _values[pos];
+	}
+
+/// Memory used by the index arrays (i.e. without the values) and the tombstones, in bytes
+	size_t indexBytes() const
+	{
+		return ( _colIds.capacity() + _colPtr.capacity() + _rowIdx.capacity() ) * sizeof(StorageIndex)
+			+ _dead.capacity() * sizeof(uint64_t);
+	}
+
+/// Iterates over the values of the \c k-th non-empty column (same as \c Eigen::SparseMatrix::InnerIterator), skips the dead values
+	class InnerIterator
+	{
+		const DcscMatrix& _mat;
+		StorageIndex      _pos;
+		StorageIndex      _end;
+		StorageIndex      _col;
+
+		void skipDead()
+		{
+			while( _pos < _end && _mat.isDead( _pos ) )
+				_pos++;
+		}
+	public:
+		InnerIterator( const DcscMatrix& mat, size_t k )
+			: _mat(mat), _pos(mat._colPtr[k]), _end(mat._colPtr[k+1]), _col(mat._colIds[k])
+		{
+			skipDead();
+		}
+		InnerIterator& operator ++ ()
+		{
+			_pos++;
+			skipDead();
+			return *this;
+		}
+		operator bool() const { return _pos < _end; }
+		StorageIndex row()   const { return _mat._rowIdx[_pos]; }
+		StorageIndex col()   const { return _col; }
+		StorageIndex index() const { return row(); }
+		const T&     value() const { return _mat._values[_pos]; }
+	};
+};
+
+#endif // DCSC_MATRIX_HPP
@@ -3,8 +3,13 @@
 \file eigen_test.cpp
 \brief A speed test for Eigen sparse matrices implementation
 
+Compares the standard CSC storage (\c Eigen::SparseMatrix) with the hypersparse one (\c DcscMatrix, see dcsc_matrix.hpp)
+
 Arguments:
 -# sparsity coeff
+-# nb of matrix sizes in the sweep. Default is 8
+-# nb of values (optional): if given, the same nb of values is used for all matrix sizes,
+instead of the sparsity coeff. Useful to sweep hypersparse matrices (for example 100000 values with matDim up to 10^7)
 */
 
 #include <eigen3/Eigen/SparseCore>
@@ -13,6 +18,9 @@ Arguments:
 #include <fstream>
 #include <set>
 #include "timing.hpp"
+#include "perf_counters.hpp"
+#include "dcsc_matrix.hpp"
+#include "presence_index.hpp"
 
 int g_tab_val[] = { 1, 2, 5 };
 char g_sep = ';';
@@ -55,53 +63,61 @@ struct MyClass
 
 /// Return true if element at \c row, \c col is empty
 /**
-see http://stackoverflow.com/questions/42053467/
+Binary search in the column (see presence_index.hpp), as in \c DcscMatrix::findElem(),
+so that the sweep only compares the representation of the outer index
 */
 template<typename T>
 bool isNull( const Eigen::SparseMatrix<T>& mat, int row, int col )
 {
-//#ifdef COUNT_SEARCH_LOOPS
-	size_t c=0;
-//#endif
-	for( typename Eigen::SparseMatrix<T>::InnerIterator it(mat, col); it; ++it )
-	{
-		c++;
-		if( it.row() == row )
-		{
-			std::cout << "*c=*" << c << '\n';
-			return false;
-		}
-	}
-	return true;
+	return isNullCsc( mat, row, col );
 }
 
-/// Fills the sparse matrix
-void
-fillMatrix( Eigen::SparseMatrix<MyClass>& mat, size_t matDim, size_t nbValues )
+/// Return true if element at \c row, \c col is empty
+template<typename T>
+bool isNull( const DcscMatrix<T>& mat, int row, int col )
+{
+	return mat.isNull( row, col );
+}
+
+/// Allocate the data the will be stored randomly in matrix
+std::vector<Eigen::Triplet<MyClass>>
+createTriplets( size_t matDim, size_t nbValues )
 {
 	std::vector<Eigen::Triplet<MyClass>> tripletList;
 	tripletList.reserve( nbValues );
 
-	for( int i=0; i<nbValues; i++ )
+	for( size_t i=0; i<nbValues; i++ )
 	{
 		MyClass object{ 5, 1.2 };
 		object.v.resize( g_vec_size );
 
-		int r = 1.0*rand()/RAND_MAX * matDim; // insert somewhere
-		int c = 1.0*rand()/RAND_MAX * matDim;
+		int r = 1.0*rand()/RAND_MAX * (matDim-1); // insert somewhere (not matDim: rand() can return RAND_MAX)
+		int c = 1.0*rand()/RAND_MAX * (matDim-1);
 
 		tripletList.push_back( Eigen::Triplet<MyClass>( r, c, object ) );
 	}
+	return tripletList;
+}
+
+/// Fills the sparse matrix
+template<typename Mat>
+void
+fillMatrix( Mat& mat, const std::vector<Eigen::Triplet<MyClass>>& tripletList )
+{
+	mat.setFromTriplets( tripletList.begin(), tripletList.end() );
 }
 
+/// Searches for random positions. The random generator is seeded with \c seed, so that all the matrices get the same searches
+template<typename Mat>
 size_t
-searchMatrix( const Eigen::SparseMatrix<MyClass>& mat, size_t matDim, size_t nbSearches )
+searchMatrix( const Mat& mat, size_t matDim, size_t nbSearches, unsigned seed )
 {
+	std::srand( seed );
 	size_t Nb = 0;
-	for( int i=0; i<nbSearches; i++ )
+	for( size_t i=0; i<nbSearches; i++ )
 	{
-		int r = 1.0*rand()/RAND_MAX * matDim;
-		int c = 1.0*rand()/RAND_MAX * matDim;
+		int r = 1.0*rand()/RAND_MAX * (matDim-1);
+		int c = 1.0*rand()/RAND_MAX * (matDim-1);
 		if( !isNull( mat, r, c ) )
 			Nb++;
 	}
@@ -117,6 +133,7 @@ int main( int argc, const char** argv )
 {
 	int nbStepsSearch = 7;
 	int nbStepsMatSize = 8;
+	size_t nbValuesFixed = 0;
 
 	std::srand(time(0));
 	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
@@ -124,13 +141,25 @@ int main( int argc, const char** argv )
 	double sparsity = 0.1;
 	if( argc>1 )
 		sparsity = std::atof( argv[1] );
-
+	if( argc>2 )
+		nbStepsMatSize = std::atoi( argv[2] );
+	if( argc>3 )
+		nbValuesFixed = static_cast<size_t>( std::atof( argv[3] ) );
 
 	std::ofstream fout( "data.dat" );
 	assert( fout.is_open() );
 
-	fout << "# i;matDim;nbValues;fill_duration;j;nbSearches;search_duration;nb values found\n";
-	fout << "# sparsity = " << sparsity << "%\n";
+	fout << "# j;matDim;nbValues;fill_duration;i;nbSearches;search_duration;nb values found"
+		<< ";dcsc_fill_duration;dcsc_search_duration;dcsc nb values found;csc_idx_bytes;dcsc_idx_bytes";
+	PerfCounters::PrintHeader( fout, g_sep, "fill_" );
+	PerfCounters::PrintHeader( fout, g_sep, "search_" );
+	PerfCounters::PrintHeader( fout, g_sep, "dcsc_fill_" );
+	PerfCounters::PrintHeader( fout, g_sep, "dcsc_search_" );
+	fout << '\n';
+	if( nbValuesFixed )
+		fout << "# nb values = " << nbValuesFixed << '\n';
+	else
+		fout << "# sparsity = " << sparsity << "%\n";
 
 	size_t pow1 = 100;
 	for( auto j=0; j<nbStepsMatSize; j++ )
@@ -138,25 +167,55 @@ int main( int argc, const char** argv )
 		if( !(j%3) )
 			pow1 *= 10;
 		size_t matDim = g_tab_val[j%3] * pow1;
-		size_t nbValues = sparsity/100.0 * matDim * matDim;
-
-		Eigen::SparseMatrix<MyClass> mat(matDim,matDim);
+		size_t nbValues = nbValuesFixed ? nbValuesFixed : sparsity/100.0 * matDim * matDim;
 
 		std::cout << j << ": matDim=" << matDim << 'x' << matDim << ", nb values=" << nbValues;
+		auto tripletList = createTriplets( matDim, nbValues );
 
+		Eigen::SparseMatrix<MyClass> mat(matDim,matDim);
+		PerfCounters countersFill;
 		Timing timing1;
-		fillMatrix( mat, matDim, nbValues );
+		fillMatrix( mat, tripletList );
 		auto durFill = timing1.getDuration();
-		std::cout << ", durFill=" << durFill << " ms\n";
+		countersFill.stop();
+
+		DcscMatrix<MyClass> mat2(matDim,matDim);
+		PerfCounters countersFill2;
+		Timing timing3;
+		fillMatrix( mat2, tripletList );
+		auto durFill2 = timing3.getDuration();
+		countersFill2.stop();
+
+		size_t cscBytes = ( mat.outerSize() + 1 + mat.nonZeros() ) * sizeof(Eigen::SparseMatrix<MyClass>::StorageIndex);
+		std::cout << ", durFill=" << durFill << " ms, dcsc durFill=" << durFill2 << " ms"
+			<< ", non-empty cols=" << mat2.outerSize()
+			<< ", index bytes csc=" << cscBytes << " dcsc=" << mat2.indexBytes() << '\n';
 		size_t pow2 = 1000;
 		for( auto i=0; i<nbStepsSearch; i++ )
 		{
 			if( !(i%3) )
 				pow2 *= 10;
 			size_t nbSearches = g_tab_val[i%3] * pow2;
+			unsigned seed = std::rand();
+			PerfCounters countersSearch;
 			Timing timing2;
-			auto n = searchMatrix( mat, matDim, nbSearches );
-			fout << j << g_sep << matDim << g_sep << nbValues << g_sep << durFill << g_sep << i << g_sep << nbSearches << g_sep << timing2.getDuration() << g_sep << n << '\n';
+			auto n = searchMatrix( mat, matDim, nbSearches, seed );
+			auto durSearch = timing2.getDuration();
+			countersSearch.stop();
+
+			PerfCounters countersSearch2;
+			Timing timing4;
+			auto n2 = searchMatrix( mat2, matDim, nbSearches, seed );
+			auto durSearch2 = timing4.getDuration();
+			countersSearch2.stop();
+
+			fout << j << g_sep << matDim << g_sep << nbValues << g_sep << durFill << g_sep << i << g_sep << nbSearches << g_sep << durSearch << g_sep << n
+				<< g_sep << durFill2 << g_sep << durSearch2 << g_sep << n2 << g_sep << cscBytes << g_sep << mat2.indexBytes();
+			countersFill.PrintValues( fout, g_sep );
+			countersSearch.PrintValues( fout, g_sep );
+			countersFill2.PrintValues( fout, g_sep );
+			countersSearch2.PrintValues( fout, g_sep );
+			fout << '\n';
 		}
 		fout << std::endl;
 
@@ -0,0 +1,186 @@
+
+/**
+\file eigen_test_10.cpp
+\brief Traversal throughput (values per second) of a sparse matrix: serial loop vs. parallel visitor (see parallel_traversal.hpp)
+
+Done for two payloads: \c MyClass (holds a \c std::vector), and \c MyPod (trivially copyable).
+For each nb of threads, prints the throughput of \c forEachNonZero() and of \c reduceNonZero() (sum of the \c b fields),
+and checks that the reduction gives exactly the same result with any nb of threads.
+
+Arguments:
+-# size of matrix n (matrix will be n x n ). Default is 10000
+-# nb of non-null values in the matrix. Default is 5000000
+-# max nb of threads (tests 1, 2, 4, ... up to this). Default is the nb of hardware threads
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "parallel_traversal.hpp"
+
+char g_sep = ';';
+
+// shouldn't change things (but who knows ?)
+constexpr int g_vec_size = 10;
+
+/// the object stored inside
+struct MyClass
+{
+	int a;
+	float b;
+	std::vector<int> v;
+
+	MyClass(){}
+	MyClass( int aa, float bb ) : a(aa), b(bb) {}
+	MyClass( int aa): a(aa) {}
+	MyClass( const MyClass& other ) // copy constructor
+	{
+		a = other.a;
+		b = other.b;
+		v = other.v;
+	}
+	MyClass& operator=( int x )
+	{
+		assert( x==0 );
+		return *this;
+	}
+
+	MyClass& operator += ( const MyClass& x )
+	{
+		return *this;
+	}
+/// operator for a = b + c
+	const MyClass& operator + ( const MyClass& c ) const
+	{
+		return *this;
+	}
+};
+
+/// Same as \c MyClass, without the vector: trivially copyable
+struct MyPod
+{
+	int a;
+	float b;
+
+	MyPod(){}
+	MyPod( int aa, float bb ) : a(aa), b(bb) {}
+	MyPod( int aa): a(aa) {}
+	MyPod& operator=( int x )
+	{
+		assert( x==0 );
+		return *this;
+	}
+
+	MyPod& operator += ( const MyPod& x )
+	{
+		return *this;
+	}
+/// operator for a = b + c
+	const MyPod& operator + ( const MyPod& c ) const
+	{
+		return *this;
+	}
+};
+
+/// a wrapper over Eigen Sparse Matrix, with serial and parallel traversal
+template<typename T>
+struct EigenSMWrapper_traversal
+{
+	Eigen::SparseMatrix<T> _data;
+
+	EigenSMWrapper_traversal( int r, int c ): _data(r,c)
+	{}
+
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie )
+	{
+		_data.setFromTriplets( ib, ie );
+	}
+/// Calls \c visitor(row,col,value) for each value
+	template<typename Visitor>
+	void forEachNonZero( Visitor visitor ) const
+	{
+		::forEachNonZero( _data, visitor );
+	}
+/// Calls \c visitor(row,col,value) for each value, in parallel (the visitor must be thread-safe)
+	template<typename Visitor>
+	void forEachNonZero( Visitor visitor, ThreadPool& pool ) const
+	{
+		::forEachNonZero( _data, visitor, pool );
+	}
+};
+
+/// Runs the traversals for payload \c T
+template<typename T>
+void
+runTraversal( const char* name, size_t matDim, size_t nbValues, int maxThreads )
+{
+	EigenSMWrapper_traversal<T> mat( matDim, matDim );
+	{
+		auto tripletList = createTriplets( matDim, nbValues, [](){ return T{ 5, 1.f * rand() / RAND_MAX }; } );
+		mat.setFromTriplets( tripletList.begin(), tripletList.end() );
+	}
+	double nnz = mat._data.nonZeros();
+
+	std::atomic<bool> found( false );
+	auto visitor = [&found]( int, int, const T& v )
+	{
+		if( v.a == -1 ) // never true, but needs to read the value
+			found.store( true, std::memory_order_relaxed );
+	};
+	auto map     = []( int, int, const T& v ){ return static_cast<double>( v.b ); };
+	auto combine = []( double x, double y ){ return x + y; };
+
+	{
+		Timing timing;
+		mat.forEachNonZero( visitor );
+		double t1 = timing.getDurationNs();
+		double sum = 0.;
+		mat.forEachNonZero( [&sum]( int, int, const T& v ){ sum += v.b; } );
+		double t2 = timing.getDurationNs();
+		std::cout << name << g_sep << "serial" << g_sep << 1000. * nnz / t1 << g_sep << 1000. * nnz / t2
+			<< g_sep << std::setprecision(17) << sum << std::setprecision(6) << '\n';
+	}
+	double ref = 0.;
+	for( int nbThreads=1; nbThreads<=maxThreads; nbThreads*=2 )
+	{
+		ThreadPool pool( nbThreads );
+		Timing timing;
+		mat.forEachNonZero( visitor, pool );
+		double t1 = timing.getDurationNs();
+		double sum = reduceNonZero( mat._data, 0., map, combine, pool );
+		double t2 = timing.getDurationNs();
+		if( nbThreads == 1 )
+			ref = sum;
+		std::cout << name << g_sep << nbThreads << g_sep << 1000. * nnz / t1 << g_sep << 1000. * nnz / t2
+			<< g_sep << std::setprecision(17) << sum << std::setprecision(6)
+			<< ( sum == ref ? "" : " Error: not deterministic" ) << '\n';
+	}
+	if( found )
+		std::cout << "found\n";
+}
+
+/// see eigen_test_10.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+	size_t matDim = 10000;
+	if( argc>1 )
+		matDim = static_cast<size_t>( std::atoi( argv[1] ) );
+	size_t nbValues = 5000000;
+	if( argc>2 )
+		nbValues = static_cast<size_t>( std::atoi( argv[2] ) );
+	int maxThreads = std::max( 1u, std::thread::hardware_concurrency() );
+	if( argc>3 )
+		maxThreads = std::atoi( argv[3] );
+
+	std::cout << "# matrix " << matDim << " x " << matDim << ", " << nbValues << " values\n";
+	std::cout << "# payload;nb threads;foreach M values/s;reduce M values/s;sum\n";
+	runTraversal<MyPod>(   "MyPod",   matDim, nbValues, maxThreads );
+	runTraversal<MyClass>( "MyClass", matDim, nbValues, maxThreads );
+}
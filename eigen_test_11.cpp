@@ -0,0 +1,119 @@
+
+/**
+\file eigen_test_11.cpp
+\brief Arithmetic throughput: sparse matrix - vector product (SpMV) with numeric scalars (\c double and \c float)
+
+The other tests use \c MyClass, whose operators are stubs, so they only measure storage and lookup.
+Here the matrix holds numbers, and for each matrix size of the sweep (same sizes as eigen_test.cpp), prints
+the GFLOP/s (2.nnz / duration) and the effective bandwidth of:
+- Eigen \c y=A*x, column-major and row-major (single thread)
+- \c spmvRowMajor(): row-major, rows split in chunks of same nb of values (see spmv.hpp)
+- \c spmvColMajor(): column-major, column blocks with a private \c y per thread, no atomics
+
+Effective bandwidth uses the minimal traffic: values + inner indexes + outer index + x + y,
+so that all the methods are compared on the same basis (the per-thread copies of \c y are not counted).
+Each result is checked against Eigen column-major.
+
+Arguments:
+-# sparsity coeff, in % (see eigen_test.cpp). Default is 0.1
+-# nb of matrix sizes in the sweep. Default is 8
+-# nb of threads. Default is the nb of hardware threads
+-# nb of products for each measure. Default is 20
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "spmv.hpp"
+
+int g_tab_val[] = { 1, 2, 5 };
+char g_sep = ';';
+
+/// Max relative difference between \c y and \c ref
+template<typename S>
+double
+maxRelDiff( const Eigen::Matrix<S,Eigen::Dynamic,1>& y, const Eigen::Matrix<S,Eigen::Dynamic,1>& ref )
+{
+	double scale = std::max( 1e-30, static_cast<double>( ref.cwiseAbs().maxCoeff() ) );
+	return static_cast<double>( ( y - ref ).cwiseAbs().maxCoeff() ) / scale;
+}
+
+/// Runs \c nbIter times \c f() and prints GFLOP/s and GB/s
+template<typename Func>
+void
+measure( Func f, int nbIter, double nnz, double bytes )
+{
+	f(); // warm-up
+	Timing timing;
+	for( int i=0; i<nbIter; i++ )
+		f();
+	double t = 1.0 * timing.getDurationNs() / nbIter;
+	std::cout << g_sep << 2. * nnz / t << g_sep << bytes / t;
+}
+
+/// Runs the sweep for scalar type \c S
+template<typename S>
+void
+runSweep( const char* name, double sparsity, int nbStepsMatSize, ThreadPool& pool, int nbIter )
+{
+	typedef Eigen::Matrix<S,Eigen::Dynamic,1> Vec;
+	std::vector<S> work;
+
+	size_t pow1 = 100;
+	for( auto j=0; j<nbStepsMatSize; j++ )
+	{
+		if( !(j%3) )
+			pow1 *= 10;
+		size_t matDim = g_tab_val[j%3] * pow1;
+		size_t nbValues = sparsity/100.0 * matDim * matDim;
+
+		Eigen::SparseMatrix<S> matC( matDim, matDim );
+		{
+			auto tripletList = createTriplets( matDim, nbValues, [](){ return S( 1.0*rand()/RAND_MAX ); } );
+			matC.setFromTriplets( tripletList.begin(), tripletList.end() );
+		}
+		Eigen::SparseMatrix<S,Eigen::RowMajor> matR( matC );
+
+		Vec x = Vec::Random( matDim );
+		Vec ref( matDim ), y1( matDim ), y2( matDim ), y3( matDim );
+		double nnz = matC.nonZeros();
+		double bytes = nnz * ( sizeof(S) + sizeof(int) ) + ( matDim + 1 ) * sizeof(int) + 2. * matDim * sizeof(S);
+
+		std::cout << name << g_sep << matDim << g_sep << matC.nonZeros() << g_sep << pool.size();
+		measure( [&](){ ref.noalias() = matC * x; }, nbIter, nnz, bytes );
+		measure( [&](){ y1.noalias() = matR * x; }, nbIter, nnz, bytes );
+		measure( [&](){ spmvRowMajor( matR, x.data(), y2.data(), pool ); }, nbIter, nnz, bytes );
+		measure( [&](){ spmvColMajor( matC, x.data(), y3.data(), pool, work ); }, nbIter, nnz, bytes );
+		std::cout << g_sep << std::max( maxRelDiff( y1, ref ), std::max( maxRelDiff( y2, ref ), maxRelDiff( y3, ref ) ) ) << std::endl;
+	}
+}
+
+/// see eigen_test_11.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+	double sparsity = 0.1;
+	if( argc>1 )
+		sparsity = std::atof( argv[1] );
+	int nbStepsMatSize = 8;
+	if( argc>2 )
+		nbStepsMatSize = std::atoi( argv[2] );
+	int nbThreads = 0;
+	if( argc>3 )
+		nbThreads = std::atoi( argv[3] );
+	int nbIter = 20;
+	if( argc>4 )
+		nbIter = std::atoi( argv[4] );
+
+	ThreadPool pool( nbThreads );
+	std::cout << "# sparsity = " << sparsity << "%, " << pool.size() << " threads, " << nbIter << " products per measure\n";
+	std::cout << "# scalar;matDim;nnz;nb threads"
+		<< ";eigen_col GFLOP/s;eigen_col GB/s;eigen_row GFLOP/s;eigen_row GB/s"
+		<< ";par_row GFLOP/s;par_row GB/s;par_col_blocked GFLOP/s;par_col_blocked GB/s;max rel diff\n";
+	runSweep<double>( "double", sparsity, nbStepsMatSize, pool, nbIter );
+	runSweep<float>(  "float",  sparsity, nbStepsMatSize, pool, nbIter );
+}
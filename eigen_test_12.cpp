@@ -0,0 +1,378 @@
+
+/**
+\file eigen_test_12.cpp
+\brief Sweep runner: lookup latency of the presence backends, with crossover detection and regression check against a baseline
+
+Instead of the fixed ladders of eigen_test.cpp, the matrix sizes, sparsities and backends are given as arguments.
+For each sparsity and each size, a random matrix is built (the seed depends only on the size and sparsity, so that
+two runs measure the same matrices), then for each backend, the lookup latency is measured \c nbRep times
+on different random probes, giving mean and standard deviation.
+
+Backends:
+- \c eigen: binary search in the CSC column (\c isNullCsc(), see presence_index.hpp)
+- \c set: \c std::set of linearized positions (as in \c EigenSMWrapper)
+- \c hash, \c bitmap: \c PresenceHash, \c PresenceBitmap (see presence_index.hpp). The bitmap is skipped above 1 GB
+- \c dcsc: \c DcscMatrix (see dcsc_matrix.hpp)
+- \c compressed: \c CompressedCscIndex (see compressed_index.hpp)
+
+Outputs:
+- on stdout, one line per point with the mean latency of each backend, then the crossovers: for each sparsity and
+each pair of backends, the sizes between which the fastest one changes (and an estimation of the crossover size,
+by linear interpolation on log(size)). Points where the two backends are not significantly different are skipped
+- the results file, one line per point and backend, that can be used as a baseline for a later run
+- if a baseline file is given, each point is compared with it using Welch's t-test (see sweep_stats.hpp).
+A regression is reported if the latency is higher with p < \c g_alpha and by more than \c g_min_slowdown.
+The program then returns 1, so it can be used in a script.
+
+Arguments:
+-# list of matrix sizes, comma separated (an empty string gives the default, for all lists). Default is 1000,2000,5000,10000,20000,50000
+-# list of sparsity coeffs, in % (see eigen_test.cpp), comma separated. Default is 0.01,0.1,1
+-# list of backends, comma separated. Default is all: eigen,set,hash,bitmap,dcsc,compressed
+-# nb of repetitions of each measure. Default is 10
+-# nb of searches in each repetition. Default is 100000
+-# results file. Default is sweep.dat
+-# baseline file (optional)
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <map>
+#include <set>
+#include <cmath>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "sweep_stats.hpp"
+#include "presence_index.hpp"
+#include "dcsc_matrix.hpp"
+#include "compressed_index.hpp"
+
+char g_sep = ';';
+
+/// threshold on the p-value of the t-test
+constexpr double g_alpha = 0.01;
+/// minimum relative slowdown to report a regression (a significant change of 1% is not worth it)
+constexpr double g_min_slowdown = 0.05;
+/// max memory used by the bitmap
+constexpr size_t g_max_bitmap_bytes = size_t(1) << 30;
+
+enum Backend
+{
+	BK_EIGEN,
+	BK_SET,
+	BK_HASH,
+	BK_BITMAP,
+	BK_DCSC,
+	BK_COMPRESSED,
+	BK_NB_BACKENDS
+};
+
+const char* g_backend_names[BK_NB_BACKENDS] = { "eigen", "set", "hash", "bitmap", "dcsc", "compressed" };
+
+/// Result of the measures of one backend on one matrix
+struct PointResult
+{
+	bool        valid = false;
+	SampleStats lookupNs;
+	double      buildMs = 0.;
+	size_t      memBytes = 0;
+};
+
+/// Splits a comma separated list
+std::vector<std::string>
+splitList( const std::string& s )
+{
+	std::vector<std::string> res;
+	std::istringstream iss( s );
+	std::string item;
+	while( std::getline( iss, item, ',' ) )
+		if( !item.empty() )
+			res.push_back( item );
+	return res;
+}
+
+/// Runs all the repetitions with \c isNullFunc (one warm-up run first)
+template<typename Func>
+SampleStats
+measureReps( Func isNullFunc, const std::vector<std::vector<std::pair<int,int>>>& probes )
+{
+	size_t nb;
+	measureProbes( isNullFunc, probes[0], nb );
+	std::vector<double> samples;
+	for( const auto& p: probes )
+		samples.push_back( measureProbes( isNullFunc, p, nb ) );
+	return SampleStats( samples );
+}
+
+/// Builds backend \c bk and measures its lookups
+PointResult
+runBackend(
+	Backend                                            bk,
+	const Eigen::SparseMatrix<float>&                  mat,
+	const std::vector<Eigen::Triplet<float>>&          tripletList,
+	const std::vector<std::vector<std::pair<int,int>>>& probes
+)
+{
+	PointResult res;
+	size_t rows = mat.rows();
+	size_t cols = mat.cols();
+	Timing timing;
+	switch( bk )
+	{
+		case BK_EIGEN:
+			res.memBytes = ( mat.outerSize() + 1 + mat.nonZeros() ) * sizeof(Eigen::SparseMatrix<float>::StorageIndex);
+			res.lookupNs = measureReps( [&](int r, int c){ return isNullCsc( mat, r, c ); }, probes );
+		break;
+		case BK_SET:
+		{
+			std::set<int64_t> idx_set;
+			for( const auto& t: tripletList )
+				idx_set.insert( static_cast<int64_t>( t.row() ) * cols + t.col() );
+			res.buildMs = timing.getDurationNs() / 1E6;
+			res.memBytes = idx_set.size() * ( sizeof(int64_t) + 4*sizeof(void*) ); // estimation: 3 pointers + color
+			res.lookupNs = measureReps(
+				[&](int r, int c){ return idx_set.find( static_cast<int64_t>(r) * cols + c ) == idx_set.cend(); },
+				probes );
+		}
+		break;
+		case BK_HASH:
+		{
+			PresenceHash hash;
+			hash.init( rows, cols, mat.nonZeros() );
+			for( const auto& t: tripletList )
+				hash.insert( t.row(), t.col() );
+			res.buildMs = timing.getDurationNs() / 1E6;
+			res.memBytes = hash.memoryBytes();
+			res.lookupNs = measureReps( [&](int r, int c){ return hash.isNull( r, c ); }, probes );
+		}
+		break;
+		case BK_BITMAP:
+		{
+			if( rows * cols / 8 > g_max_bitmap_bytes )
+				return res;
+			PresenceBitmap bitmap;
+			bitmap.init( rows, cols );
+			for( const auto& t: tripletList )
+				bitmap.insert( t.row(), t.col() );
+			res.buildMs = timing.getDurationNs() / 1E6;
+			res.memBytes = bitmap.memoryBytes();
+			res.lookupNs = measureReps( [&](int r, int c){ return bitmap.isNull( r, c ); }, probes );
+		}
+		break;
+		case BK_DCSC:
+		{
+			DcscMatrix<float> dcsc( rows, cols );
+			dcsc.setFromTriplets( tripletList.begin(), tripletList.end() );
+			res.buildMs = timing.getDurationNs() / 1E6;
+			res.memBytes = dcsc.indexBytes();
+			res.lookupNs = measureReps( [&](int r, int c){ return dcsc.isNull( r, c ); }, probes );
+		}
+		break;
+		case BK_COMPRESSED:
+		{
+			CompressedCscIndex cidx;
+			cidx.build( mat );
+			res.buildMs = timing.getDurationNs() / 1E6;
+			res.memBytes = cidx.memoryBytes();
+			res.lookupNs = measureReps( [&](int r, int c){ return cidx.isNull( r, c ); }, probes );
+		}
+		break;
+		default: assert(0);
+	}
+	res.valid = true;
+	return res;
+}
+
+/// Key of a result in the results file: "backend;sparsity;matDim"
+std::string
+getKey( const std::string& backend, double sparsity, size_t matDim )
+{
+	std::ostringstream oss;
+	oss << backend << g_sep << sparsity << g_sep << matDim;
+	return oss.str();
+}
+
+/// Reads a results file written by a previous run
+std::map<std::string,SampleStats>
+readBaseline( const char* fname )
+{
+	std::map<std::string,SampleStats> res;
+	std::ifstream fin( fname );
+	if( !fin.is_open() )
+	{
+		std::cerr << "Error: unable to open baseline file " << fname << '\n';
+		std::exit( 2 );
+	}
+	std::string line;
+	while( std::getline( fin, line ) )
+	{
+		if( line.empty() || line[0] == '#' )
+			continue;
+		std::vector<std::string> f;
+		std::istringstream iss( line );
+		std::string item;
+		while( std::getline( iss, item, g_sep ) )
+			f.push_back( item );
+		if( f.size() < 7 )
+			continue;
+		res[ f[0] + g_sep + f[1] + g_sep + f[2] ] = SampleStats( std::stoul( f[4] ), std::stod( f[5] ), std::stod( f[6] ) );
+	}
+	return res;
+}
+
+/// Prints the sizes where the fastest of two backends changes, for one sparsity
+void
+printCrossovers(
+	std::ostream&                                  os,
+	double                                         sparsity,
+	const std::vector<size_t>&                     sizes,
+	const std::vector<Backend>&                    backends,
+	const std::vector<std::vector<PointResult>>&   results    ///< [size][backend]
+)
+{
+	for( size_t a=0; a<backends.size(); a++ )
+		for( size_t b=a+1; b<backends.size(); b++ )
+		{
+			double prevDiff = 0.;
+			size_t prevSize = 0;
+			for( size_t i=0; i<sizes.size(); i++ )
+			{
+				const auto& ra = results[i][a];
+				const auto& rb = results[i][b];
+				if( !ra.valid || !rb.valid )
+					continue;
+				double diff = ra.lookupNs.mean - rb.lookupNs.mean;
+				auto w = welchTest( ra.lookupNs, rb.lookupNs );
+				if( w.p > g_alpha && w.p < 1. - g_alpha ) // not significant: considered equal, does not change the winner
+					continue;
+				if( prevSize && diff * prevDiff < 0. )
+				{
+					double x0 = std::log( prevSize );
+					double x1 = std::log( sizes[i] );
+					double xc = x0 + ( x1 - x0 ) * prevDiff / ( prevDiff - diff );
+					const char* winnerBefore = g_backend_names[ backends[ prevDiff < 0. ? a : b ] ];
+					const char* winnerAfter  = g_backend_names[ backends[ diff < 0. ? a : b ] ];
+					os << "# crossover" << g_sep << sparsity << g_sep << winnerBefore << g_sep << winnerAfter
+						<< g_sep << prevSize << g_sep << sizes[i] << g_sep << std::round( std::exp( xc ) ) << '\n';
+				}
+				prevDiff = diff;
+				prevSize = sizes[i];
+			}
+		}
+}
+
+/// see eigen_test_12.cpp
+int main( int argc, const char** argv )
+{
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+
+	std::vector<size_t> sizes;
+	for( const auto& s: splitList( argc>1 && *argv[1] ? argv[1] : "1000,2000,5000,10000,20000,50000" ) )
+		sizes.push_back( std::stoul( s ) );
+	std::vector<double> sparsities;
+	for( const auto& s: splitList( argc>2 && *argv[2] ? argv[2] : "0.01,0.1,1" ) )
+		sparsities.push_back( std::stod( s ) );
+	std::vector<Backend> backends;
+	for( const auto& s: splitList( argc>3 && *argv[3] ? argv[3] : "eigen,set,hash,bitmap,dcsc,compressed" ) )
+	{
+		int k = 0;
+		while( k < BK_NB_BACKENDS && s != g_backend_names[k] )
+			k++;
+		if( k == BK_NB_BACKENDS )
+		{
+			std::cerr << "Error: unknown backend " << s << '\n';
+			return 2;
+		}
+		backends.push_back( static_cast<Backend>( k ) );
+	}
+	int nbRep = 10;
+	if( argc>4 )
+		nbRep = std::max( 2, std::atoi( argv[4] ) );
+	size_t nbSearches = 100000;
+	if( argc>5 )
+		nbSearches = static_cast<size_t>( std::atof( argv[5] ) );
+	const char* outName = argc>6 ? argv[6] : "sweep.dat";
+	std::map<std::string,SampleStats> baseline;
+	if( argc>7 )
+		baseline = readBaseline( argv[7] );
+
+	std::ofstream fout( outName );
+	assert( fout.is_open() );
+	fout << "# backend;sparsity;matDim;nnz;nbRep;lookup_mean_ns;lookup_stddev_ns;build_ms;memory_bytes\n";
+
+	std::cout << "# " << nbRep << " repetitions of " << nbSearches << " searches\n";
+	std::cout << "# sparsity;matDim;nnz";
+	for( auto bk: backends )
+		std::cout << g_sep << g_backend_names[bk] << " ns";
+	std::cout << '\n';
+
+	std::ostringstream crossovers;
+	std::ostringstream regressions;
+	size_t nbRegressions = 0;
+	size_t nbCompared = 0;
+	for( auto sparsity: sparsities )
+	{
+		std::vector<std::vector<PointResult>> results;
+		for( auto matDim: sizes )
+		{
+			std::srand( static_cast<unsigned>( matDim * 1000003 + sparsity * 1E6 ) );
+			size_t nbValues = sparsity/100.0 * matDim * matDim;
+			auto tripletList = createTriplets( matDim, nbValues );
+			Eigen::SparseMatrix<float> mat( matDim, matDim );
+			mat.setFromTriplets( tripletList.begin(), tripletList.end() );
+
+			std::vector<std::vector<std::pair<int,int>>> probes;
+			for( int r=0; r<nbRep; r++ )
+				probes.push_back( createProbes( matDim, nbSearches ) );
+
+			std::cout << sparsity << g_sep << matDim << g_sep << mat.nonZeros() << std::flush;
+			results.push_back( std::vector<PointResult>() );
+			for( auto bk: backends )
+			{
+				auto res = runBackend( bk, mat, tripletList, probes );
+				results.back().push_back( res );
+				if( !res.valid )
+				{
+					std::cout << g_sep << "nan" << std::flush;
+					continue;
+				}
+				std::cout << g_sep << std::setprecision(3) << res.lookupNs.mean << std::setprecision(6) << std::flush;
+				std::string key = getKey( g_backend_names[bk], sparsity, matDim );
+				fout << key << g_sep << mat.nonZeros() << g_sep << res.lookupNs.n
+					<< g_sep << res.lookupNs.mean << g_sep << res.lookupNs.stddev
+					<< g_sep << res.buildMs << g_sep << res.memBytes << '\n';
+
+				auto it = baseline.find( key );
+				if( it == baseline.end() )
+					continue;
+				nbCompared++;
+				auto w = welchTest( res.lookupNs, it->second );
+				double slowdown = res.lookupNs.mean / it->second.mean - 1.;
+				if( w.p < g_alpha && slowdown > g_min_slowdown )
+				{
+					nbRegressions++;
+					regressions << "# REGRESSION" << g_sep << key << g_sep << it->second.mean << " ns -> " << res.lookupNs.mean
+						<< " ns" << g_sep << "+" << 100. * slowdown << "%" << g_sep << "t=" << w.t << g_sep << "p=" << w.p << '\n';
+				}
+			}
+			std::cout << std::endl;
+		}
+		printCrossovers( crossovers, sparsity, sizes, backends, results );
+	}
+
+	std::cout << "# crossover;sparsity;faster below;faster above;size before;size after;estimated size\n" << crossovers.str();
+	fout << crossovers.str();
+
+	if( argc>7 )
+	{
+		std::cout << "# baseline " << argv[7] << ": " << nbCompared << " points compared, "
+			<< nbRegressions << " regressions (p < " << g_alpha << ", slowdown > " << 100. * g_min_slowdown << "%)\n"
+			<< regressions.str();
+		if( nbRegressions )
+			return 1;
+	}
+}
@@ -0,0 +1,148 @@
+
+/**
+\file eigen_test_13.cpp
+\brief Lookup throughput and dTLB misses with different allocation policies of the matrix arrays (see huge_alloc.hpp)
+
+The wrapper copies the Eigen matrix into a \c PagedCscMatrix and builds a \c PagedBitmap presence index,
+both allocated with the policy given to the wrapper. For each policy, prints:
+- the huge pages really obtained, and the amount of memory backed by transparent huge pages
+- the fill duration (parallel for the first-touch policy)
+- for lookups in the CSC arrays (binary search) and in the bitmap: the mean duration and the nb of dTLB misses per lookup
+(see perf_counters.hpp, "NaN" if not available)
+
+Arguments:
+-# size of matrix n (matrix will be n x n ). Default is 40000 (200 MB bitmap)
+-# nb of non-null values in the matrix. Default is 20000000
+-# nb of searches. Default is 5000000
+-# nb of threads for the first-touch fill. Default is the nb of hardware threads
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "perf_counters.hpp"
+#include "huge_alloc.hpp"
+
+char g_sep = ';';
+
+/// a wrapper over Eigen Sparse Matrix: its arrays and presence bitmap are allocated according to \c AllocPolicy
+template<typename T>
+struct EigenSMWrapper_paged
+{
+	AllocPolicy       _policy;
+	PagedCscMatrix<T> _data;
+	PagedBitmap       _presence;
+	size_t            _rows;
+	size_t            _cols;
+
+	EigenSMWrapper_paged( int r, int c, AllocPolicy policy ): _policy(policy), _rows(r), _cols(c)
+	{}
+
+	bool isNull( int r, int c ) const
+	{
+		return _presence.isNull( r, c );
+	}
+/// With the first-touch policy, \c pool is used to fill the arrays
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie, ThreadPool& pool )
+	{
+		ThreadPool* fillPool = _policy.numa == NP_FIRST_TOUCH ? &pool : nullptr;
+		{
+			Eigen::SparseMatrix<T> tmp( _rows, _cols );
+			tmp.setFromTriplets( ib, ie );
+			_data.build( tmp, _policy, fillPool );
+		}
+		_presence.init( _rows, _cols, _policy, fillPool );
+		for( auto it = ib;it != ie; ++it )
+			_presence.insert( it->row(), it->col() );
+	}
+};
+
+/// Prints the mean duration of a probe (ns) and the nb of dTLB misses per probe. \c isNullFunc is called on each probe
+template<typename Func>
+size_t
+measureProbesTlb( Func isNullFunc, const std::vector<std::pair<int,int>>& probes )
+{
+	size_t nb = 0;
+	PerfCounters counters;
+	Timing timing;
+	for( const auto& p: probes )
+		if( !isNullFunc( p.first, p.second ) )
+			nb++;
+	double t = 1.0 * timing.getDurationNs() / probes.size();
+	counters.stop();
+	g_nbFound = g_nbFound + nb;
+
+	std::cout << g_sep << t << g_sep;
+	if( counters.isValid( PE_DTLB_MISSES ) )
+		std::cout << 1.0 * counters.get( PE_DTLB_MISSES ) / probes.size();
+	else
+		std::cout << "NaN";
+	return nb;
+}
+
+/// see eigen_test_13.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+	size_t matDim = 40000;
+	if( argc>1 )
+		matDim = static_cast<size_t>( std::atoi( argv[1] ) );
+	size_t nbValues = 20000000;
+	if( argc>2 )
+		nbValues = static_cast<size_t>( std::atof( argv[2] ) );
+	size_t nbSearches = 5000000;
+	if( argc>3 )
+		nbSearches = static_cast<size_t>( std::atof( argv[3] ) );
+	int nbThreads = 0;
+	if( argc>4 )
+		nbThreads = std::atoi( argv[4] );
+
+	ThreadPool pool( nbThreads );
+	auto tripletList = createTriplets( matDim, nbValues );
+	auto probes = createProbes( matDim, nbSearches );
+
+	std::cout << "# matrix " << matDim << " x " << matDim << ", " << nbValues << " values, " << nbSearches << " searches, "
+		<< pool.size() << " threads, NUMA node mask=0x" << std::hex << getNumaNodeMask() << std::dec << '\n';
+	std::cout << "# huge pages;numa;obtained;interleaved;THP MB;memory MB;fill ms"
+		<< ";csc lookup ns;csc dTLB miss/lookup;bitmap lookup ns;bitmap dTLB miss/lookup\n";
+
+	const AllocPolicy policies[] = {
+		AllocPolicy( HP_NONE,        NP_DEFAULT ),
+		AllocPolicy( HP_TRANSPARENT, NP_DEFAULT ),
+		AllocPolicy( HP_EXPLICIT,    NP_DEFAULT ),
+		AllocPolicy( HP_NONE,        NP_INTERLEAVE ),
+		AllocPolicy( HP_TRANSPARENT, NP_INTERLEAVE ),
+		AllocPolicy( HP_NONE,        NP_FIRST_TOUCH ),
+		AllocPolicy( HP_TRANSPARENT, NP_FIRST_TOUCH )
+	};
+	size_t ref = 0;
+	bool first = true;
+	for( const auto& policy: policies )
+	{
+		EigenSMWrapper_paged<float> mat( matDim, matDim, policy );
+		Timing timing;
+		mat.setFromTriplets( tripletList.begin(), tripletList.end(), pool );
+		auto durFill = timing.getDuration();
+
+		std::cout << getHugePagePolicyName( policy.huge ) << g_sep << getNumaPolicyName( policy.numa )
+			<< g_sep << getHugePagePolicyName( mat._data._inner.getHugePages() )
+			<< g_sep << mat._data._inner.isInterleaved()
+			<< g_sep << getAnonHugeBytes() / 1024 / 1024
+			<< g_sep << ( mat._data.memoryBytes() + mat._presence.memoryBytes() ) / 1024 / 1024
+			<< g_sep << durFill << std::setprecision(3);
+		size_t nb1 = measureProbesTlb( [&](int r, int c){ return mat._data.isNull( r, c ); }, probes );
+		size_t nb2 = measureProbesTlb( [&](int r, int c){ return mat.isNull( r, c ); }, probes );
+		std::cout << std::setprecision(6) << std::endl;
+		if( first )
+			ref = nb1;
+		first = false;
+		if( nb1 != ref || nb2 != ref )
+			std::cerr << "Error: different nb of values found: " << ref << ' ' << nb1 << ' ' << nb2 << '\n';
+	}
+}
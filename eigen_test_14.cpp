@@ -0,0 +1,314 @@
+
+/**
+\file eigen_test_14.cpp
+\brief Speed and memory of value removal (see tombstone_matrix.hpp) vs. a full rebuild, for growing churn rates
+
+For each churn rate f (ratio of the values removed) and each presence index kind (bitmap, hash, CSC),
+the values whose field \c b is below f (random in [0,1]) are removed, in three ways:
+- one by one, with \c erase() (compaction is done automatically when 25% of the values are dead)
+- in bulk, with \c eraseIf()
+- by a rebuild: the remaining values are extracted and the wrapper is filled again (current workaround)
+
+Prints the durations, the nb of compactions done during the erases, and the memory used by the wrapper
+(matrix arrays + tombstones + presence indexes) before and after, and checks that the \c std::set,
+the presence index and the matrix are consistent, and that the three ways give the same result.
+
+Then, for each churn rate, the same values are removed one by one from the other presence backends
+(\c ShardedPresence, \c LockFreePresence, \c ShapedHash, \c DcscMatrix, \c CompressedCscIndex),
+and their lookups are checked against the matrix. Prints the duration and the memory of the index before and after
+(NaN for \c ShardedPresence, that has no memory estimation).
+
+Arguments:
+-# size of matrix n (matrix will be n x n ). Default is 5000
+-# nb of non-null values in the matrix. Default is 500000
+-# nb of searches for the consistency check. Default is 100000
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <set>
+#include <algorithm>
+#include <random>
+#include <limits>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "presence_index.hpp"
+#include "tombstone_matrix.hpp"
+#include "concurrent_presence.hpp"
+#include "fixed_shape.hpp"
+#include "dcsc_matrix.hpp"
+#include "compressed_index.hpp"
+
+char g_sep = ';';
+
+// shouldn't change things (but who knows ?)
+constexpr int g_vec_size = 10;
+
+/// the object stored inside
+struct MyClass
+{
+	int a;
+	float b;
+	std::vector<int> v;
+
+	MyClass(){}
+	MyClass( int aa, float bb ) : a(aa), b(bb) {}
+	MyClass( int aa): a(aa) {}
+	MyClass( const MyClass& other ) // copy constructor
+	{
+		a = other.a;
+		b = other.b;
+		v = other.v;
+	}
+	MyClass& operator=( int x )
+	{
+		assert( x==0 );
+		return *this;
+	}
+
+	MyClass& operator += ( const MyClass& x )
+	{
+		return *this;
+	}
+/// operator for a = b + c
+	const MyClass& operator + ( const MyClass& c ) const
+	{
+		return *this;
+	}
+};
+
+/// Value of the elements created by \c createTriplets()
+MyClass makeObject()
+{
+	MyClass object{ 5, 1.f * rand() / RAND_MAX };
+	object.v.resize( g_vec_size );
+	return object;
+}
+
+/// a wrapper over Eigen Sparse Matrix, adds a std::set of linearized positions and a presence index, with removal of values
+template<typename T>
+struct EigenSMWrapper_tombstone
+{
+	std::set<int64_t>   _idx_set;
+	TombstoneMatrix<T>  _data;
+	AdaptivePresence<T> _presence;
+	PresenceKind        _kind;
+
+	EigenSMWrapper_tombstone( int r, int c, PresenceKind kind ): _data(r,c), _kind(kind)
+	{}
+
+	bool isNull( int r, int c ) const
+	{
+		int64_t idx = static_cast<int64_t>(r) * _data.cols() + c;
+		return _idx_set.find( idx ) == _idx_set.cend();
+	}
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie )
+	{
+		_data.setFromTriplets( ib, ie );
+		_idx_set.clear();
+		for( auto it = ib;it != ie; ++it )
+			_idx_set.insert( static_cast<int64_t>( it->row() ) * _data.cols() + it->col() );
+		_presence.build( _data._data, _kind, &_data._dead );
+	}
+/// Removes element \c r, \c c from the matrix and from the indexes. Returns false if it was already empty
+	bool erase( int r, int c )
+	{
+		if( !_data.erase( r, c ) )
+			return false;
+		_idx_set.erase( static_cast<int64_t>(r) * _data.cols() + c );
+		_presence.erase( r, c );
+		return true;
+	}
+/// Removes all the values for which \c pred(row,col,value) returns true
+	template<typename Pred>
+	size_t eraseIf( Pred pred )
+	{
+		return _data.eraseIf(
+			pred,
+			[this]( int r, int c )
+			{
+				_idx_set.erase( static_cast<int64_t>(r) * _data.cols() + c );
+				_presence.erase( r, c );
+			}
+		);
+	}
+/// Estimation for the set: 3 pointers + color per node
+	size_t memoryBytes() const
+	{
+		return _data.memoryBytes() + _presence.memoryBytes() + _idx_set.size() * ( sizeof(int64_t) + 4*sizeof(void*) );
+	}
+};
+
+/// Checks that the set, the presence index and the matrix agree. Returns the nb of probes found
+template<typename T>
+size_t
+checkConsistency( const EigenSMWrapper_tombstone<T>& mat, const std::vector<std::pair<int,int>>& probes )
+{
+	size_t nb = 0;
+	for( const auto& p: probes )
+	{
+		bool n1 = mat.isNull( p.first, p.second );
+		if( n1 != mat._presence.isNull( p.first, p.second ) || n1 != mat._data.isNull( p.first, p.second ) )
+		{
+			std::cerr << "Error: indexes not consistent at " << p.first << ',' << p.second << '\n';
+			break;
+		}
+		nb += !n1;
+	}
+	if( mat._idx_set.size() != mat._data.nonZeros() )
+		std::cerr << "Error: " << mat._idx_set.size() << " values in set, " << mat._data.nonZeros() << " in matrix\n";
+	return nb;
+}
+
+/// Removes \c victims one by one from presence backend \c index, prints the duration and the memory given by \c memFunc,
+/// and checks the lookups and the nb of values (given by \c sizeFunc) against \c ref, from which the same values were removed
+template<typename Index, typename SizeFunc, typename MemFunc>
+void
+eraseBackend(
+	const char*                            name,
+	double                                 churn,
+	Index&                                 index,
+	SizeFunc                               sizeFunc,
+	MemFunc                                memFunc,
+	const std::vector<std::pair<int,int>>& victims,
+	const EigenSMWrapper_tombstone<MyClass>& ref,
+	const std::vector<std::pair<int,int>>& probes
+)
+{
+	double memBefore = memFunc() / 1024. / 1024.;
+	size_t nbErased = 0;
+	Timing timing;
+	for( const auto& p: victims )
+		nbErased += index.erase( p.first, p.second );
+	double t = timing.getDurationNs() / 1E6;
+
+	bool ok = nbErased == victims.size() && sizeFunc() == ref._data.nonZeros();
+	for( const auto& p: victims )
+		ok = ok && index.isNull( p.first, p.second ) && !index.erase( p.first, p.second );
+	for( const auto& p: probes )
+		ok = ok && index.isNull( p.first, p.second ) == ref.isNull( p.first, p.second );
+	if( !ok )
+		std::cerr << "Error: " << name << " not consistent with the matrix\n";
+
+	std::cout << churn << g_sep << name << g_sep << nbErased << g_sep << t << g_sep << nbErased / t / 1000.
+		<< g_sep << memBefore << g_sep << memFunc() / 1024. / 1024. << std::endl;
+}
+
+/// see eigen_test_14.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+	size_t matDim = 5000;
+	if( argc>1 )
+		matDim = static_cast<size_t>( std::atoi( argv[1] ) );
+	size_t nbValues = 500000;
+	if( argc>2 )
+		nbValues = static_cast<size_t>( std::atof( argv[2] ) );
+	size_t nbSearches = 100000;
+	if( argc>3 )
+		nbSearches = static_cast<size_t>( std::atof( argv[3] ) );
+
+	auto tripletList = createTriplets( matDim, nbValues, makeObject );
+	std::mt19937 rng( std::rand() );
+	auto probes = createProbes( matDim, nbSearches );
+
+	std::cout << "# matrix " << matDim << " x " << matDim << ", " << nbValues << " values\n";
+	std::cout << "# churn;presence;nb erased;erase_ms;M erase/s;compactions;eraseIf_ms;rebuild_ms"
+		<< ";mem_before_MB;mem_erase_MB;mem_eraseIf_MB;mem_rebuild_MB\n";
+
+	const double churns[] = { 0.001, 0.01, 0.1, 0.3, 0.5 };
+	const PresenceKind kinds[] = { PK_BITMAP, PK_HASH, PK_CSC };
+	for( auto churn: churns )
+		for( auto kind: kinds )
+		{
+			auto pred = [churn]( int, int, const MyClass& v ){ return v.b < churn; };
+
+		// one by one
+			EigenSMWrapper_tombstone<MyClass> mat1( matDim, matDim, kind );
+			mat1.setFromTriplets( tripletList.begin(), tripletList.end() );
+			double memBefore = mat1.memoryBytes() / 1024. / 1024.;
+			std::vector<std::pair<int,int>> victims;
+			mat1._data.forEachNonZero( [&]( int r, int c, const MyClass& v ){ if( pred( r, c, v ) ) victims.push_back( std::make_pair( r, c ) ); } );
+			std::shuffle( victims.begin(), victims.end(), rng );
+			Timing timing1;
+			for( const auto& p: victims )
+				mat1.erase( p.first, p.second );
+			double t1 = timing1.getDurationNs() / 1E6;
+
+		// in bulk
+			EigenSMWrapper_tombstone<MyClass> mat2( matDim, matDim, kind );
+			mat2.setFromTriplets( tripletList.begin(), tripletList.end() );
+			Timing timing2;
+			size_t nb2 = mat2.eraseIf( pred );
+			double t2 = timing2.getDurationNs() / 1E6;
+
+		// rebuild
+			double t3;
+			EigenSMWrapper_tombstone<MyClass> mat3( matDim, matDim, kind );
+			{
+				EigenSMWrapper_tombstone<MyClass> src( matDim, matDim, kind );
+				src.setFromTriplets( tripletList.begin(), tripletList.end() );
+				Timing timing3;
+				std::vector<Eigen::Triplet<MyClass>> remaining;
+				remaining.reserve( src._data.nonZeros() );
+				src._data.forEachNonZero( [&]( int r, int c, const MyClass& v ){ if( !pred( r, c, v ) ) remaining.push_back( Eigen::Triplet<MyClass>( r, c, v ) ); } );
+				mat3.setFromTriplets( remaining.begin(), remaining.end() );
+				t3 = timing3.getDurationNs() / 1E6;
+			}
+
+			size_t nbFound1 = checkConsistency( mat1, probes );
+			size_t nbFound2 = checkConsistency( mat2, probes );
+			size_t nbFound3 = checkConsistency( mat3, probes );
+			if( nb2 != victims.size() || nbFound1 != nbFound2 || nbFound1 != nbFound3
+				|| mat1._data.nonZeros() != mat3._data.nonZeros() || mat2._data.nonZeros() != mat3._data.nonZeros() )
+				std::cerr << "Error: different results\n";
+
+			std::cout << churn << g_sep << getPresenceKindName( kind ) << g_sep << victims.size()
+				<< g_sep << t1 << g_sep << victims.size() / t1 / 1000. << g_sep << mat1._data._nbCompactions
+				<< g_sep << t2 << g_sep << t3
+				<< g_sep << memBefore << g_sep << mat1.memoryBytes() / 1024. / 1024. << g_sep << mat2.memoryBytes() / 1024. / 1024.
+				<< g_sep << mat3.memoryBytes() / 1024. / 1024. << std::endl;
+		}
+
+	std::cout << "# churn;backend;nb erased;erase_ms;M erase/s;mem_before_MB;mem_after_MB\n";
+	for( auto churn: churns )
+	{
+		auto pred = [churn]( int, int, const MyClass& v ){ return v.b < churn; };
+		EigenSMWrapper_tombstone<MyClass> ref( matDim, matDim, PK_CSC );
+		ref.setFromTriplets( tripletList.begin(), tripletList.end() );
+		const auto& data = ref._data._data;
+		size_t nnz = data.nonZeros();
+
+		ShardedPresence<64> sharded( matDim, matDim, nnz );
+		LockFreePresence lockFree( matDim, matDim, nnz );
+		ShapedHash<RuntimeShape> hash( matDim, matDim );
+		hash.init( nnz );
+		for( int k=0; k<data.outerSize(); ++k )
+			for( Eigen::SparseMatrix<MyClass>::InnerIterator it(data,k); it; ++it )
+			{
+				sharded.insert( it.row(), it.col() );
+				lockFree.insert( it.row(), it.col() );
+				hash.insert( it.row(), it.col() );
+			}
+		DcscMatrix<MyClass> dcsc( matDim, matDim );
+		dcsc.setFromTriplets( tripletList.begin(), tripletList.end() );
+		CompressedCscIndex cidx;
+		cidx.build( data ); // before the erases, as compaction moves the values
+
+		std::vector<std::pair<int,int>> victims;
+		ref._data.forEachNonZero( [&]( int r, int c, const MyClass& v ){ if( pred( r, c, v ) ) victims.push_back( std::make_pair( r, c ) ); } );
+		std::shuffle( victims.begin(), victims.end(), rng );
+		for( const auto& p: victims )
+			ref.erase( p.first, p.second );
+
+		eraseBackend( "sharded", churn, sharded, [&](){ return sharded.size(); }, [](){ return std::numeric_limits<double>::quiet_NaN(); }, victims, ref, probes );
+		eraseBackend( "lock-free", churn, lockFree, [&](){ return lockFree.size(); }, [&](){ return 1. * lockFree.memoryBytes(); }, victims, ref, probes );
+		eraseBackend( "shaped hash", churn, hash, [&](){ return hash.size(); }, [&](){ return 1. * hash.memoryBytes(); }, victims, ref, probes );
+		eraseBackend( "dcsc", churn, dcsc, [&](){ return dcsc.nonZeros(); }, [&](){ return 1. * dcsc.indexBytes(); }, victims, ref, probes );
+		eraseBackend( "compressed", churn, cidx, [&](){ return cidx.nonZeros(); }, [&](){ return 1. * cidx.memoryBytes(); }, victims, ref, probes );
+	}
+}
@@ -0,0 +1,139 @@
+
+/**
+\file eigen_test_15.cpp
+\brief Lookup speed with the matrix shape known at compile time vs. at run time (see fixed_shape.hpp)
+
+For a few matrix sizes fixed at compile time, the same wrapper and presence indexes are instantiated with
+\c RuntimeShape and with \c FixedShape, and prints the mean lookup duration (ns) of:
+- the wrapper (\c std::set of keys, 64 bits with the runtime shape, \c Index with the fixed one)
+- \c ShapedHash (open addressing)
+- \c ShapedBitmap (skipped above 1 GB)
+
+and the memory used by the hash tables.
+
+Arguments:
+-# sparsity coeff, in % (see eigen_test.cpp). Default is 0.02
+-# nb of searches. Default is 2000000
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <set>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "fixed_shape.hpp"
+
+char g_sep = ';';
+
+/// max memory used by the bitmaps
+constexpr size_t g_max_bitmap_bytes = size_t(1) << 30;
+
+/// a wrapper over Eigen Sparse Matrix, adds a std::set of keys computed by \c Shape
+template<typename T, typename Shape=RuntimeShape>
+struct EigenSMWrapper_shape
+{
+	Shape                            _shape;
+	std::set<typename Shape::Key>    _idx_set;
+	Eigen::SparseMatrix<T>           _data;
+
+	EigenSMWrapper_shape( int r, int c ): _shape(r,c), _data(r,c)
+	{}
+
+	bool isNull( int r, int c ) const
+	{
+		return _idx_set.find( _shape.key( r, c ) ) == _idx_set.cend();
+	}
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie )
+	{
+		_data.setFromTriplets( ib, ie );
+		for( auto it = ib;it != ie; ++it )
+			_idx_set.insert( _shape.key( it->row(), it->col() ) );
+	}
+};
+
+/// Measures the lookups with \c Shape, prints the durations, and returns the nb of values found (for checking)
+template<typename Shape>
+std::vector<size_t>
+runShape(
+	size_t                                     matDim,
+	const std::vector<Eigen::Triplet<float>>&  tripletList,
+	const std::vector<std::pair<int,int>>&     probes,
+	size_t&                                    hashBytes
+)
+{
+	std::vector<size_t> nb( 3, 0 );
+	double t1, t2, t3 = 0.;
+	{
+		EigenSMWrapper_shape<float,Shape> mat( matDim, matDim );
+		mat.setFromTriplets( tripletList.begin(), tripletList.end() );
+		t1 = measureProbes( [&](int r, int c){ return mat.isNull( r, c ); }, probes, nb[0] );
+	}
+	{
+		ShapedHash<Shape> hash( matDim, matDim );
+		hash.init( tripletList.size() );
+		for( const auto& t: tripletList )
+			hash.insert( t.row(), t.col() );
+		t2 = measureProbes( [&](int r, int c){ return hash.isNull( r, c ); }, probes, nb[1] );
+		hashBytes = hash.memoryBytes();
+	}
+	if( matDim * matDim / 8 <= g_max_bitmap_bytes )
+	{
+		ShapedBitmap<Shape> bitmap( matDim, matDim );
+		for( const auto& t: tripletList )
+			bitmap.insert( t.row(), t.col() );
+		t3 = measureProbes( [&](int r, int c){ return bitmap.isNull( r, c ); }, probes, nb[2] );
+	}
+	else
+		nb[2] = nb[0];
+	std::cout << g_sep << t1 << g_sep << t2 << g_sep;
+	if( t3 )
+		std::cout << t3;
+	else
+		std::cout << "nan";
+	return nb;
+}
+
+/// Runs the comparison for a \c FixedShape
+template<typename Fixed>
+void
+compareShapes( double sparsity, size_t nbSearches )
+{
+	volatile size_t dim = Fixed::rows(); // so that the runtime shape is really unknown at compile time
+	size_t matDim = dim;
+	size_t nbValues = sparsity/100.0 * matDim * matDim;
+	auto tripletList = createTriplets( matDim, nbValues );
+	auto probes = createProbes( matDim, nbSearches );
+
+	std::cout << matDim << g_sep << sizeof(typename Fixed::Key) * 8 << g_sep << nbValues << std::setprecision(3);
+	size_t bytesRt, bytesFx;
+	auto nbRt = runShape<RuntimeShape>( matDim, tripletList, probes, bytesRt );
+	auto nbFx = runShape<Fixed>(        matDim, tripletList, probes, bytesFx );
+	std::cout << g_sep << bytesRt / 1024. / 1024. << g_sep << bytesFx / 1024. / 1024. << std::setprecision(6) << std::endl;
+	for( int i=0; i<3; i++ )
+		if( nbRt[i] != nbRt[0] || nbFx[i] != nbRt[0] )
+			std::cerr << "Error: different nb of values found\n";
+}
+
+/// see eigen_test_15.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+	double sparsity = 0.02;
+	if( argc>1 )
+		sparsity = std::atof( argv[1] );
+	size_t nbSearches = 2000000;
+	if( argc>2 )
+		nbSearches = static_cast<size_t>( std::atof( argv[2] ) );
+
+	std::cout << "# sparsity = " << sparsity << "%, " << nbSearches << " searches\n";
+	std::cout << "# matDim;fixed key bits;nbValues"
+		<< ";rt set ns;rt hash ns;rt bitmap ns;fixed set ns;fixed hash ns;fixed bitmap ns;rt hash MB;fixed hash MB\n";
+	compareShapes<FixedShape<1000,1000>>( sparsity, nbSearches );
+	compareShapes<FixedShape<10000,10000>>( sparsity, nbSearches );
+	compareShapes<FixedShape<50000,50000>>( sparsity, nbSearches );
+	compareShapes<FixedShape<100000,100000,uint64_t>>( sparsity, nbSearches );
+}
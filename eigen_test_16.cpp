@@ -0,0 +1,116 @@
+
+/**
+\file eigen_test_16.cpp
+\brief Speed of batch lookups with branchless result output (see batch_lookup.hpp) vs. the per-probe branching loop
+
+For three lookup methods (dense presence bitmap, CSC binary search with \c std::lower_bound, branchless CSC binary search)
+and four ways of using the results:
+- \c branch: <code>if( !isNull ) nb++</code>, as in the other test programs
+- \c count: <code>nb += !isNull</code>
+- \c bitmap: hit bitmap, then popcount
+- \c select: selection vector of the probes found
+
+prints the mean duration per probe (ns) and the nb of branch misses per probe (see perf_counters.hpp, NaN if not available).
+The matrix is dense enough so that hits and misses are both frequent (that is the worst case for the branch predictor).
+
+Arguments:
+-# size of matrix n (matrix will be n x n ). Default is 3000
+-# density coeff, in % of the matrix (before removal of duplicates). Default is 50
+-# nb of searches. Default is 5000000
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "perf_counters.hpp"
+#include "presence_index.hpp"
+#include "batch_lookup.hpp"
+
+char g_sep = ';';
+
+/// Runs \c f() (that returns the nb of probes found), prints the duration per probe and the branch misses per probe
+template<typename Func>
+size_t
+measure( Func f, size_t nbProbes )
+{
+	PerfCounters counters;
+	Timing timing;
+	size_t nb = f();
+	double t = 1.0 * timing.getDurationNs() / nbProbes;
+	counters.stop();
+	g_nbFound = g_nbFound + nb;
+
+	std::cout << g_sep << t << g_sep;
+	if( counters.isValid( PE_BRANCH_MISSES ) )
+		std::cout << 1.0 * counters.get( PE_BRANCH_MISSES ) / nbProbes;
+	else
+		std::cout << "NaN";
+	return nb;
+}
+
+/// Runs the four ways with lookup \c isNullFunc, returns true if they all give the same count
+template<typename Func>
+bool
+runModes( const char* name, Func isNullFunc, const std::vector<std::pair<int,int>>& probes )
+{
+	std::vector<uint64_t> bits;
+	std::vector<uint32_t> sel;
+	std::cout << name << std::setprecision(3);
+	size_t nb1 = measure(
+		[&]()
+		{
+			size_t nb = 0;
+			for( const auto& p: probes )
+				if( !isNullFunc( p.first, p.second ) )
+					nb++;
+			return nb;
+		},
+		probes.size() );
+	size_t nb2 = measure( [&](){ return lookupCount( isNullFunc, probes ); }, probes.size() );
+	size_t nb3 = measure( [&](){ lookupToBitmap( isNullFunc, probes, bits ); return popcountBitmap( bits ); }, probes.size() );
+	size_t nb4 = measure( [&](){ return lookupToSelection( isNullFunc, probes, sel ); }, probes.size() );
+	std::cout << g_sep << 1. * nb1 / probes.size() << std::setprecision(6) << std::endl;
+
+	size_t nb5 = 0; // check that the selection vector and the bitmap hold the same probes
+	forEachSetBit( bits, [&]( size_t i ){ nb5 += nb5 < sel.size() && sel[nb5] == i; } );
+	return nb1 == nb2 && nb1 == nb3 && nb1 == nb4 && nb1 == nb5;
+}
+
+/// see eigen_test_16.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+	size_t matDim = 3000;
+	if( argc>1 )
+		matDim = static_cast<size_t>( std::atoi( argv[1] ) );
+	double density = 50;
+	if( argc>2 )
+		density = std::atof( argv[2] );
+	size_t nbSearches = 5000000;
+	if( argc>3 )
+		nbSearches = static_cast<size_t>( std::atof( argv[3] ) );
+
+	Eigen::SparseMatrix<float> mat( matDim, matDim );
+	{
+		auto tripletList = createTriplets( matDim, density/100.0 * matDim * matDim );
+		mat.setFromTriplets( tripletList.begin(), tripletList.end() );
+	}
+	PresenceBitmap bitmap;
+	bitmap.init( matDim, matDim );
+	for( int k=0; k<mat.outerSize(); ++k )
+		for( Eigen::SparseMatrix<float>::InnerIterator it(mat,k); it; ++it )
+			bitmap.insert( it.row(), it.col() );
+	auto probes = createProbes( matDim, nbSearches );
+
+	std::cout << "# matrix " << matDim << " x " << matDim << ", " << mat.nonZeros() << " values, " << nbSearches << " searches\n";
+	std::cout << "# lookup;branch ns;branch br_miss;count ns;count br_miss;bitmap ns;bitmap br_miss;select ns;select br_miss;hit ratio\n";
+	bool ok = runModes( "bitmap",     [&](int r, int c){ return bitmap.isNull( r, c ); },                  probes );
+	ok = runModes( "csc",             [&](int r, int c){ return isNullCsc( mat, r, c ); },              probes ) && ok;
+	ok = runModes( "csc_branchless",  [&](int r, int c){ return isNullCscBranchless( mat, r, c ); },    probes ) && ok;
+	if( !ok )
+		std::cerr << "Error: different results\n";
+}
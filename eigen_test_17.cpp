@@ -0,0 +1,110 @@
+
+/**
+\file eigen_test_17.cpp
+\brief Interleaved lookups with coroutines (see coro_lookup.hpp) vs. synchronous lookups, on a matrix larger than the cache
+
+Prints the mean duration of a lookup (ns) for:
+- the wrapper (\c std::set), synchronous, as reference
+- the same positions in an ordered array-based tree (\c EytzingerSet): synchronous, and with coroutines
+- the Eigen CSC matrix: synchronous (\c std::lower_bound, and branchless binary search), and with coroutines
+- the open-addressing hash (\c ShapedHash): synchronous, and with coroutines
+
+The coroutine versions are run for a growing nb of lookups in flight (1 shows the overhead of the coroutines).
+
+Arguments:
+-# size of matrix n (matrix will be n x n ). Default is 200000
+-# nb of non-null values in the matrix. Default is 20000000
+-# nb of searches. Default is 2000000
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "presence_index.hpp"
+#include "batch_lookup.hpp"
+#include "coro_lookup.hpp"
+
+char g_sep = ';';
+
+/// Returns the mean duration of a probe, in ns, with \c groupSize coroutines \c makeTask(row,col) in flight
+template<typename MakeTask>
+double
+measureInterleaved( MakeTask makeTask, const std::vector<std::pair<int,int>>& probes, size_t groupSize, size_t& nb )
+{
+	nb = 0;
+	Timing timing;
+	runInterleaved(
+		probes.size(),
+		groupSize,
+		[&]( size_t i ){ return makeTask( probes[i].first, probes[i].second ); },
+		[&]( size_t, bool isNull ){ nb += !isNull; }
+	);
+	double t = 1.0 * timing.getDurationNs() / probes.size();
+	g_nbFound = g_nbFound + nb;
+	return t;
+}
+
+/// see eigen_test_17.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+	size_t matDim = 200000;
+	if( argc>1 )
+		matDim = static_cast<size_t>( std::atoi( argv[1] ) );
+	size_t nbValues = 20000000;
+	if( argc>2 )
+		nbValues = static_cast<size_t>( std::atof( argv[2] ) );
+	size_t nbSearches = 2000000;
+	if( argc>3 )
+		nbSearches = static_cast<size_t>( std::atof( argv[3] ) );
+
+	auto probes = createProbes( matDim, nbSearches );
+	EigenSMWrapper<float> mat( matDim, matDim );
+	ShapedHash<RuntimeShape> hash( matDim, matDim );
+	EytzingerSet tree;
+	{
+		auto tripletList = createTriplets( matDim, nbValues );
+		mat.setFromTriplets( tripletList.begin(), tripletList.end() );
+		hash.init( tripletList.size() );
+		for( const auto& t: tripletList )
+			hash.insert( t.row(), t.col() );
+		tree.build( matDim, mat._idx_set.begin(), mat._idx_set.end() );
+	}
+	size_t cscBytes = ( mat._data.outerSize() + 1 + mat._data.nonZeros() ) * sizeof(int);
+	std::cout << "# matrix " << matDim << " x " << matDim << ", " << mat._data.nonZeros() << " values, " << nbSearches << " searches"
+		<< ", CSC index " << cscBytes / 1024 / 1024 << " MB, hash " << hash.memoryBytes() / 1024 / 1024
+		<< " MB, tree " << tree.memoryBytes() / 1024 / 1024 << " MB, LLC " << getLLCSize() / 1024 / 1024 << " MB\n";
+
+	size_t nbRef, nb;
+	std::cout << std::setprecision(3);
+	std::cout << "# synchronous;ns\n";
+	std::cout << "set"            << g_sep << measureProbes( [&](int r, int c){ return mat.isNull( r, c ); }, probes, nbRef ) << std::endl;
+	bool ok = true;
+	std::cout << "eytzinger"      << g_sep << measureProbes( [&](int r, int c){ return tree.isNull( r, c ); }, probes, nb ) << std::endl;
+	ok = ok && nb == nbRef;
+	std::cout << "csc"            << g_sep << measureProbes( [&](int r, int c){ return isNullCsc( mat._data, r, c ); }, probes, nb ) << std::endl;
+	ok = ok && nb == nbRef;
+	std::cout << "csc_branchless" << g_sep << measureProbes( [&](int r, int c){ return isNullCscBranchless( mat._data, r, c ); }, probes, nb ) << std::endl;
+	ok = ok && nb == nbRef;
+	std::cout << "hash"           << g_sep << measureProbes( [&](int r, int c){ return hash.isNull( r, c ); }, probes, nb ) << std::endl;
+	ok = ok && nb == nbRef;
+
+	std::cout << "# in flight;eytzinger coro ns;csc coro ns;hash coro ns\n";
+	for( size_t groupSize=1; groupSize<=64; groupSize*=2 )
+	{
+		std::cout << groupSize;
+		std::cout << g_sep << measureInterleaved( [&](int r, int c){ return isNullEytzingerCoro( tree, r, c ); }, probes, groupSize, nb );
+		ok = ok && nb == nbRef;
+		std::cout << g_sep << measureInterleaved( [&](int r, int c){ return isNullCscCoro( mat._data, r, c ); }, probes, groupSize, nb );
+		ok = ok && nb == nbRef;
+		std::cout << g_sep << measureInterleaved( [&](int r, int c){ return isNullHashCoro( hash, r, c ); }, probes, groupSize, nb );
+		ok = ok && nb == nbRef;
+		std::cout << std::endl;
+	}
+	if( !ok )
+		std::cerr << "Error: different nb of values found\n";
+}
@@ -0,0 +1,224 @@
+
+/**
+\file eigen_test_18.cpp
+\brief Succinct rank/select presence index (see rank_select.hpp) vs. the set, hash and CSC backends: memory and lookup speed
+
+For growing matrix sizes, prints:
+- memory of the index, in bytes per value (for CSC: outer + inner index arrays)
+- mean duration of a presence lookup (ns): wrapper (\c std::set), \c PresenceHash, CSC binary search,
+one-level and two-level rank/select bitvectors
+- mean duration of a lookup that gives the position of the value in the value array (ns): \c findCsc() and rank
+- mean duration of a select (position of the k-th value), and of its CSC equivalent (search in the outer index)
+
+The rank/select backends are skipped (NaN) when their bitvector would be larger than 1 GB.
+A rank is up to 8 popcounts: build with \c -mpopcnt (or \c -march=native), else they are done in software.
+
+Arguments:
+-# sparsity coeff, in % of the matrix (before removal of duplicates). Default is 0.1
+-# nb of steps of matrix size (size is 1000, then doubled at each step). Default is 6
+-# nb of non-null values in the matrix, 0 to use the sparsity coeff. Default is 0
+-# nb of searches. Default is 1000000
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "presence_index.hpp"
+#include "rank_select.hpp"
+
+char g_sep = ';';
+
+/// max size of a rank/select bitvector
+const size_t g_maxBitvectorBytes = size_t(1) << 30;
+
+/// Returns the mean duration of a probe, in ns. \c findFunc returns the position of the value, or -1.
+/// \c sum is the sum of the positions found
+template<typename Func>
+double
+measureFind( Func findFunc, const std::vector<std::pair<int,int>>& probes, size_t& sum )
+{
+	sum = 0;
+	Timing timing;
+	for( const auto& p: probes )
+	{
+		std::ptrdiff_t pos = findFunc( p.first, p.second );
+		if( pos >= 0 )
+			sum += pos;
+	}
+	double t = 1.0 * timing.getDurationNs() / probes.size();
+	g_nbFound = g_nbFound + sum;
+	return t;
+}
+
+/// Returns the mean duration of a call to \c positionFunc(k), in ns. \c sum is the sum of the rows and columns
+template<typename Func>
+double
+measureSelect( Func positionFunc, const std::vector<size_t>& ranks, size_t& sum )
+{
+	sum = 0;
+	Timing timing;
+	for( auto k: ranks )
+	{
+		std::pair<int,int> p = positionFunc( k );
+		sum += p.first + p.second;
+	}
+	double t = 1.0 * timing.getDurationNs() / ranks.size();
+	g_nbFound = g_nbFound + sum;
+	return t;
+}
+
+/// Checks the presence, position and select functions of rank/select index \c rs against the CSC matrix
+template<typename RS>
+bool
+check( const RS& rs, const Eigen::SparseMatrix<float>& mat )
+{
+	if( rs.nonZeros() != static_cast<size_t>( mat.nonZeros() ) )
+		return false;
+	for( int k=0; k<mat.outerSize(); ++k )
+		for( Eigen::SparseMatrix<float>::InnerIterator it(mat,k); it; ++it )
+		{
+			std::ptrdiff_t pos = &it.value() - mat.valuePtr();
+			if( rs.find( it.row(), it.col() ) != pos || rs._values[pos] != it.value() )
+				return false;
+			if( rs.position( pos ) != std::make_pair( static_cast<int>( it.row() ), static_cast<int>( it.col() ) ) )
+				return false;
+		}
+	return true;
+}
+
+/// Runs the lookups of rank/select index \c rs, or prints NaN if \c rs is empty
+template<typename RS>
+bool
+runRankSelect(
+	const RS&                              rs,
+	const std::vector<std::pair<int,int>>& probes,
+	const std::vector<size_t>&             ranks,
+	size_t                                 nbRef,
+	size_t                                 sumFindRef,
+	size_t                                 sumSelectRef,
+	double&                                tIsNull,
+	double&                                tFind,
+	double&                                tSelect
+)
+{
+	tIsNull = tFind = tSelect = std::numeric_limits<double>::quiet_NaN();
+	if( rs._rows == 0 )
+		return true;
+	size_t nb, sumFind, sumSelect;
+	tIsNull = measureProbes( [&](int r, int c){ return rs.isNull( r, c ); }, probes, nb );
+	tFind   = measureFind( [&](int r, int c){ return rs.find( r, c ); }, probes, sumFind );
+	tSelect = measureSelect( [&](size_t k){ return rs.position( k ); }, ranks, sumSelect );
+	return nb == nbRef && sumFind == sumFindRef && sumSelect == sumSelectRef;
+}
+
+/// see eigen_test_18.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+	double sparsity = 0.1;
+	if( argc>1 )
+		sparsity = std::atof( argv[1] );
+	int nbSteps = 6;
+	if( argc>2 )
+		nbSteps = std::atoi( argv[2] );
+	size_t nbValuesFixed = 0;
+	if( argc>3 )
+		nbValuesFixed = static_cast<size_t>( std::atof( argv[3] ) );
+	size_t nbSearches = 1000000;
+	if( argc>4 )
+		nbSearches = static_cast<size_t>( std::atof( argv[4] ) );
+
+	std::cout << "# sparsity=" << sparsity << "%, " << nbSearches << " searches, LLC " << getLLCSize() / 1024 / 1024 << " MB\n";
+	std::cout << "# size;nnz;non-empty cols"
+		<< ";set B/val;hash B/val;csc B/val;rank B/val;rank2 B/val"
+		<< ";set ns;hash ns;csc ns;rank ns;rank2 ns"
+		<< ";csc find ns;rank find ns;rank2 find ns"
+		<< ";csc select ns;rank select ns;rank2 select ns\n";
+
+	bool ok = true;
+	size_t matDim = 1000;
+	for( int step=0; step<nbSteps; step++, matDim *= 2 )
+	{
+		size_t nbValues = nbValuesFixed ? nbValuesFixed : sparsity/100.0 * matDim * matDim;
+		EigenSMWrapper<float> mat( matDim, matDim );
+		{
+			auto tripletList = createTriplets( matDim, nbValues );
+			mat.setFromTriplets( tripletList.begin(), tripletList.end() );
+		}
+		const auto& data = mat._data;
+		size_t nnz = data.nonZeros();
+
+		PresenceHash hash;
+		hash.init( matDim, matDim, nnz );
+		for( int k=0; k<data.outerSize(); ++k )
+			for( Eigen::SparseMatrix<float>::InnerIterator it(data,k); it; ++it )
+				hash.insert( it.row(), it.col() );
+
+		size_t nbNonEmptyCols = 0;
+		for( int k=0; k<data.outerSize(); ++k )
+			nbNonEmptyCols += data.outerIndexPtr()[k+1] != data.outerIndexPtr()[k];
+
+		RankSelectMatrix<float> rank;
+		if( matDim * matDim / 8 <= g_maxBitvectorBytes )
+			rank.build( data );
+		TwoLevelRankSelectMatrix<float> rank2;
+		if( nbNonEmptyCols * matDim / 8 <= g_maxBitvectorBytes )
+			rank2.build( data );
+
+		auto probes = createProbes( matDim, nbSearches );
+		std::vector<size_t> ranks( nnz ? nbSearches : 0 );
+		for( auto& k: ranks )
+			k = 1.0*rand()/RAND_MAX * (nnz-1);
+
+		size_t cscBytes = ( data.outerSize() + 1 + nnz ) * sizeof(int);
+		double perValue = nnz ? 1.0 / nnz : 0.;
+		std::cout << std::setprecision(3) << matDim << g_sep << nnz << g_sep << nbNonEmptyCols
+			<< g_sep << mat.setBytes() * perValue
+			<< g_sep << hash.memoryBytes() * perValue
+			<< g_sep << cscBytes * perValue;
+		if( rank._rows )
+			std::cout << g_sep << rank.indexBytes() * perValue;
+		else
+			std::cout << g_sep << "NaN";
+		if( rank2._rows )
+			std::cout << g_sep << rank2.indexBytes() * perValue;
+		else
+			std::cout << g_sep << "NaN";
+
+		size_t nbRef, nb, sumFindRef, sumSelectRef;
+		std::cout << g_sep << measureProbes( [&](int r, int c){ return mat.isNull( r, c ); }, probes, nbRef );
+		std::cout << g_sep << measureProbes( [&](int r, int c){ return hash.isNull( r, c ); }, probes, nb );
+		ok = ok && nb == nbRef;
+		std::cout << g_sep << measureProbes( [&](int r, int c){ return isNullCsc( data, r, c ); }, probes, nb );
+		ok = ok && nb == nbRef;
+
+		double t1, t1Find, t1Select, t2, t2Find, t2Select;
+		double tCscFind = measureFind( [&](int r, int c){ return findCsc( data, r, c ); }, probes, sumFindRef );
+		double tCscSelect = measureSelect(
+			[&]( size_t k )
+			{
+				const auto* outer = data.outerIndexPtr();
+				int c = std::upper_bound( outer, outer + data.outerSize() + 1, static_cast<int>( k ) ) - outer - 1;
+				return std::make_pair( static_cast<int>( data.innerIndexPtr()[k] ), c );
+			},
+			ranks,
+			sumSelectRef
+		);
+		ok = runRankSelect( rank, probes, ranks, nbRef, sumFindRef, sumSelectRef, t1, t1Find, t1Select ) && ok;
+		ok = runRankSelect( rank2, probes, ranks, nbRef, sumFindRef, sumSelectRef, t2, t2Find, t2Select ) && ok;
+		std::cout << g_sep << t1 << g_sep << t2
+			<< g_sep << tCscFind << g_sep << t1Find << g_sep << t2Find
+			<< g_sep << tCscSelect << g_sep << t1Select << g_sep << t2Select
+			<< std::setprecision(6) << std::endl;
+
+		if( step == 0 )
+			ok = ( !rank._rows || check( rank, data ) ) && ( !rank2._rows || check( rank2, data ) ) && ok;
+	}
+	if( !ok )
+		std::cerr << "Error: different results\n";
+}
@@ -16,6 +16,8 @@ Arguments:
 #include <iostream>
 #include <set>
 #include "timing.hpp"
+#include "perf_counters.hpp"
+#include "alloc_tracking.hpp"
 
 
 // shouldn't change things (but who knows ?)
@@ -160,28 +162,45 @@ int main( int argc, const char** argv )
 
 	std::cout << "\n1 - create Triplets\n";
 
+	AllocTracker allocs0;
+	PerfCounters counters0;
 	Timing timing0;
 	auto tripletList = createTriplets( matDim, nbValues );
+	counters0.stop(); // before printing, so that the output is not counted
 	timing0.PrintDuration();
+	counters0.PrintCounters();
+	allocs0.PrintStats();
 
 	std::cout << "\n2 - fill sparse matrix:\n";
 
 	{
 		std::cout << " - direct\n";
+		AllocTracker allocs;
+		PerfCounters counters;
 		Timing timing;
 		mat1.setFromTriplets( tripletList.begin(), tripletList.end() );
+		counters.stop();
 		timing.PrintDuration();
+		counters.PrintCounters();
+		allocs.PrintStats();
 	}
 
 	{
 		std::cout << " - using wrapper set\n";
+		AllocTracker allocs;
+		PerfCounters counters;
 		Timing timing;
 		mat2.setFromTriplets( tripletList.begin(), tripletList.end() );
+		counters.stop();
 		timing.PrintDuration();
+		counters.PrintCounters();
+		allocs.PrintStats();
 	}
 
 	{
 		std::cout << "\n3 - searching for " << nbSearches << " values in matrix...\n";
+		AllocTracker allocs;
+		PerfCounters counters;
 		Timing timing;
 		size_t Nb_1 = 0;
 		for( int i=0; i<nbSearches; i++ )
@@ -191,10 +210,15 @@ int main( int argc, const char** argv )
 			if( !isNull( mat1, r, c ) )
 				Nb_1++;
 		}
+		counters.stop();
 		std::cout << "  Results:\n - direct eigen matrix: nbvalues=" << Nb_1 << "\n";
 		timing.PrintDuration();
+		counters.PrintCounters();
+		allocs.PrintStats();
 	}
 	{
+		AllocTracker allocs;
+		PerfCounters counters;
 		Timing timing;
 		size_t Nb_2 = 0;
 		for( int i=0; i<nbSearches; i++ )
@@ -204,8 +228,11 @@ int main( int argc, const char** argv )
 			if( !mat2.isNull( r, c ) )
 				Nb_2++;
 		}
+		counters.stop();
 		std::cout << " - wrapper1 class: nbvalues=" << Nb_2 << "\n";
 		timing.PrintDuration();
+		counters.PrintCounters();
+		allocs.PrintStats();
 	}
 }
 
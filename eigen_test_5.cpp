@@ -0,0 +1,219 @@
+
+/**
+\file eigen_test_5.cpp
+\brief A speed test of the density-adaptive presence index (bitmap, hash or CSC), see presence_index.hpp
+
+First calibrates the cost model on the current machine, then sweeps the matrix size (same ladder as eigen_test.cpp)
+and, for each size, prints the representation chosen, its estimated cost, and the measured cost of all three.
+
+Arguments:
+-# sparsity coeff, in % (see eigen_test.cpp). Default is 0.1
+-# nb of matrix sizes in the sweep. Default is 6
+-# nb of searches performed for each measure. Default is 1000000
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "presence_index.hpp"
+
+int g_tab_val[] = { 1, 2, 5 };
+
+// shouldn't change things (but who knows ?)
+constexpr int g_vec_size = 10;
+
+/// the object stored inside
+struct MyClass
+{
+	int a;
+	float b;
+	std::vector<int> v;
+
+	MyClass(){}
+	MyClass( int aa, float bb ) : a(aa), b(bb) {}
+	MyClass( int aa): a(aa) {}
+	MyClass( const MyClass& other ) // copy constructor
+	{
+		a = other.a;
+		b = other.b;
+		v = other.v;
+	}
+	MyClass& operator=( int x )
+	{
+		assert( x==0 );
+		return *this;
+	}
+
+	MyClass& operator += ( const MyClass& x )
+	{
+		return *this;
+	}
+/// operator for a = b + c
+	const MyClass& operator + ( const MyClass& c ) const
+	{
+		return *this;
+	}
+};
+
+/// Value of the elements created by \c createTriplets()
+MyClass makeObject()
+{
+	MyClass object{ 5, 1.2 };
+	object.v.resize( g_vec_size );
+	return object;
+}
+
+/// a wrapper over Eigen Sparse Matrix, adds a presence index whose representation depends on the density
+template<typename T>
+struct EigenSMWrapper_adaptive
+{
+	Eigen::SparseMatrix<T> _data;
+	AdaptivePresence<T>    _presence;
+
+	EigenSMWrapper_adaptive( int r, int c ): _data(r,c)
+	{}
+
+	bool isNull( int r, int c ) const
+	{
+		return _presence.isNull( r, c );
+	}
+/// Fills the matrix, and selects the presence representation again
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie )
+	{
+		_data.setFromTriplets( ib, ie );
+		_presence.build( _data );
+	}
+};
+
+/// Measures the cost of a probe for each representation with the given kind forced
+double
+measureKind( const Eigen::SparseMatrix<MyClass>& mat, PresenceKind kind, const std::vector<std::pair<int,int>>& probes )
+{
+	AdaptivePresence<MyClass> presence;
+	presence.build( mat, kind );
+	size_t nb;
+	return measureProbes( [&](int r, int c){ return presence.isNull( r, c ); }, probes, nb );
+}
+
+/// Sets the constants of the cost model from measures on small matrices (that fit in cache), and one large bitmap
+void
+calibrateModel( PresenceCostModel& model, size_t nbSearches )
+{
+	std::cout << "# calibration...\n";
+	size_t matDim = 1000;
+	auto probes = createProbes( matDim, nbSearches );
+
+	Eigen::SparseMatrix<MyClass> mat1( matDim, matDim ); // ~1 value per column
+	auto triplets = createTriplets( matDim, matDim, makeObject );
+	mat1.setFromTriplets( triplets.begin(), triplets.end() );
+
+	Eigen::SparseMatrix<MyClass> mat2( matDim, matDim ); // ~64 values per column
+	triplets = createTriplets( matDim, 64*matDim, makeObject );
+	mat2.setFromTriplets( triplets.begin(), triplets.end() );
+
+	model.bitmapNs = measureKind( mat1, PK_BITMAP, probes );
+	model.hashNs   = measureKind( mat1, PK_HASH,   probes );
+
+	double csc1 = measureKind( mat1, PK_CSC, probes );
+	double csc2 = measureKind( mat2, PK_CSC, probes );
+	double steps1 = std::log2( 1. + 1.*mat1.nonZeros()/matDim );
+	double steps2 = std::log2( 1. + 1.*mat2.nonZeros()/matDim );
+	model.cscStepNs = std::max( 0., ( csc2 - csc1 ) / ( steps2 - steps1 ) );
+	model.cscBaseNs = std::max( 0., csc1 - model.cscStepNs * steps1 );
+
+// cache size and DRAM penalty: random accesses in bitmaps of growing size
+// (the size given by the system is not always the one that matters, e.g. in a VM)
+	double tSmall = 0., tBig = 0.;
+	size_t bigBytes = 0;
+	model.llcBytes = size_t(1)<<20;
+	for( size_t bytes = size_t(1)<<20; bytes <= size_t(256)<<20; bytes *= 4 )
+	{
+		size_t bigDim = std::sqrt( 8. * bytes );
+		PresenceBitmap bitmap;
+		bitmap.init( bigDim, bigDim );
+		auto bigProbes = createProbes( bigDim, nbSearches );
+		size_t nb;
+		double t = measureProbes( [&](int r, int c){ return bitmap.isNull( r, c ); }, bigProbes, nb );
+		std::cout << "# bitmap " << (bitmap.memoryBytes()>>10) << " kB: " << t << " ns\n";
+		if( !bigBytes )
+			tSmall = t;
+		else if( t < 2. * tSmall )
+			model.llcBytes = bitmap.memoryBytes();
+		tBig = t;
+		bigBytes = bitmap.memoryBytes();
+	}
+	if( model.missRatio( bigBytes ) > 0. )
+		model.missNs = std::max( 0., ( tBig - model.bitmapNs ) / model.missRatio( bigBytes ) );
+	else
+		std::cout << "# no cache effect measured, using default DRAM penalty\n";
+
+	std::cout << "# bitmapNs=" << model.bitmapNs << " hashNs=" << model.hashNs
+		<< " cscBaseNs=" << model.cscBaseNs << " cscStepNs=" << model.cscStepNs
+		<< " missNs=" << model.missNs << " (LLC=" << (model.llcBytes>>20) << " MB)\n";
+}
+
+/// see eigen_test_5.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+
+	double sparsity = 0.1;
+	if( argc>1 )
+		sparsity = std::atof( argv[1] );
+	int nbStepsMatSize = 6;
+	if( argc>2 )
+		nbStepsMatSize = std::atoi( argv[2] );
+	size_t nbSearches = 1000000;
+	if( argc>3 )
+		nbSearches = static_cast<size_t>( std::atoi( argv[3] ) );
+
+	std::cout << "# sparsity = " << sparsity << "%, nb searches = " << nbSearches << '\n';
+
+	PresenceCostModel model;
+	calibrateModel( model, nbSearches );
+
+	std::cout << "# matDim;nbValues;chosen;estimated_ns;bitmap_ns;hash_ns;csc_ns;best\n";
+	size_t pow1 = 100;
+	for( auto j=0; j<nbStepsMatSize; j++ )
+	{
+		if( !(j%3) )
+			pow1 *= 10;
+		size_t matDim = g_tab_val[j%3] * pow1;
+		size_t nbValues = sparsity/100.0 * matDim * matDim;
+
+		auto tripletList = createTriplets( matDim, nbValues, makeObject );
+		EigenSMWrapper_adaptive<MyClass> mat( matDim, matDim );
+		mat._presence._model = model;
+		mat.setFromTriplets( tripletList.begin(), tripletList.end() );
+
+		auto probes = createProbes( matDim, nbSearches );
+		std::cout << matDim << ';' << nbValues
+			<< ';' << getPresenceKindName( mat._presence.getKind() )
+			<< ';' << std::setprecision(3) << mat._presence.getEstimatedCost();
+
+		PresenceKind best = PK_CSC;
+		double bestCost = std::numeric_limits<double>::infinity();
+		for( int k=0; k<PK_NB_KINDS; k++ )
+		{
+			PresenceKind kind = static_cast<PresenceKind>(k);
+			if( model.memoryBytes( kind, matDim, matDim, nbValues ) > model.memBudget )
+			{
+				std::cout << ";-";
+				continue;
+			}
+			double t = measureKind( mat._data, kind, probes );
+			std::cout << ';' << t;
+			if( t < bestCost )
+			{
+				bestCost = t;
+				best = kind;
+			}
+		}
+		std::cout << ';' << getPresenceKindName( best ) << std::endl;
+	}
+}
@@ -0,0 +1,116 @@
+
+/**
+\file eigen_test_6.cpp
+\brief Memory footprint and lookup speed of the compressed inner indices (see compressed_index.hpp) vs. uncompressed CSC
+
+For each matrix size (same ladder as eigen_test.cpp), prints the bytes per value of the index
+(outer + inner arrays for CSC), the mean lookup latency, and the traversal time per value.
+Values are \c float, as only the index is measured here.
+
+Arguments:
+-# sparsity coeff, in % (see eigen_test.cpp). Default is 0.1
+-# nb of matrix sizes in the sweep. Default is 6
+-# nb of searches performed for each measure. Default is 1000000
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "presence_index.hpp"
+#include "compressed_index.hpp"
+
+int g_tab_val[] = { 1, 2, 5 };
+char g_sep = ';';
+
+/// Return true if element at \c row, \c col is empty
+/**
+see http://stackoverflow.com/questions/42053467/
+*/
+template<typename T>
+bool isNull( const Eigen::SparseMatrix<T>& mat, int row, int col )
+{
+	for( typename Eigen::SparseMatrix<T>::InnerIterator it(mat, col); it; ++it )
+	{
+		if( it.row() == row )
+			return false;
+	}
+	return true;
+}
+
+/// Returns the duration of a full traversal, in ns per value. \c sum is the sum of the row indexes
+template<typename Mat>
+double
+measureTraversal( const Mat& mat, size_t nbCols, size_t nnz, size_t& sum )
+{
+	sum = 0;
+	Timing timing;
+	for( size_t k=0; k<nbCols; ++k )
+		for( typename Mat::InnerIterator it(mat,k); it; ++it )
+			sum += it.row();
+	double t = 1.0 * timing.getDurationNs() / std::max( nnz, size_t(1) );
+	g_nbFound = g_nbFound + sum;
+	return t;
+}
+
+/// see eigen_test_6.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+
+	double sparsity = 0.1;
+	if( argc>1 )
+		sparsity = std::atof( argv[1] );
+	int nbStepsMatSize = 6;
+	if( argc>2 )
+		nbStepsMatSize = std::atoi( argv[2] );
+	size_t nbSearches = 1000000;
+	if( argc>3 )
+		nbSearches = static_cast<size_t>( std::atoi( argv[3] ) );
+
+	std::cout << "# sparsity = " << sparsity << "%, nb searches = " << nbSearches << '\n';
+	std::cout << "# matDim;nbValues;csc_bytes/nnz;compressed_bytes/nnz;csc_linear_ns;csc_binary_ns;compressed_ns;csc_iter_ns/nnz;compressed_iter_ns/nnz\n";
+
+	size_t pow1 = 100;
+	for( auto j=0; j<nbStepsMatSize; j++ )
+	{
+		if( !(j%3) )
+			pow1 *= 10;
+		size_t matDim = g_tab_val[j%3] * pow1;
+		size_t nbValues = sparsity/100.0 * matDim * matDim;
+
+		Eigen::SparseMatrix<float> mat( matDim, matDim );
+		{
+			auto tripletList = createTriplets( matDim, nbValues );
+			mat.setFromTriplets( tripletList.begin(), tripletList.end() );
+		}
+		CompressedCscIndex cidx;
+		cidx.build( mat );
+
+		size_t nnz = mat.nonZeros();
+		double cscBytes = ( mat.outerSize() + 1. + nnz ) * sizeof(Eigen::SparseMatrix<float>::StorageIndex);
+
+		auto probes = createProbes( matDim, nbSearches );
+		size_t nb1, nb2, nb3;
+		double t1 = measureProbes( [&](int r, int c){ return isNull( mat, r, c ); },    probes, nb1 );
+		double t2 = measureProbes( [&](int r, int c){ return isNullCsc( mat, r, c ); }, probes, nb2 );
+		double t3 = measureProbes( [&](int r, int c){ return cidx.isNull( r, c ); },    probes, nb3 );
+		if( nb1 != nb2 || nb1 != nb3 )
+			std::cerr << "Error: different nb of values found: " << nb1 << ' ' << nb2 << ' ' << nb3 << '\n';
+
+		size_t sum1, sum2;
+		double it1 = measureTraversal( mat,  matDim, nnz, sum1 );
+		double it2 = measureTraversal( cidx, matDim, nnz, sum2 );
+		if( sum1 != sum2 )
+			std::cerr << "Error: traversal gives different results\n";
+
+		std::cout << std::setprecision(3) << matDim << g_sep << nbValues
+			<< g_sep << cscBytes / std::max( nnz, size_t(1) )
+			<< g_sep << 1. * cidx.memoryBytes() / std::max( nnz, size_t(1) )
+			<< g_sep << t1 << g_sep << t2 << g_sep << t3
+			<< g_sep << it1 << g_sep << it2 << std::endl;
+	}
+}
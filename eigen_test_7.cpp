@@ -0,0 +1,251 @@
+
+/**
+\file eigen_test_7.cpp
+\brief Reader throughput and latency while the matrix is continuously rebuilt by another thread
+
+Compares:
+- a wrapper protected by a reader/writer lock: readers have to wait while \c setFromTriplets() runs
+- the snapshot wrapper (see snapshot_wrapper.hpp): the new version is built aside, and published atomically
+
+For each, prints the nb of queries per second (all readers), the latency percentiles of a query, and the nb of rebuilds done.
+
+Arguments:
+-# size of matrix n (matrix will be n x n ). Default is 10000
+-# nb of non-null values in the matrix. Default is 200000
+-# nb of reader threads. Default is 3
+-# duration of each run, in ms. Default is 2000
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <shared_mutex>
+#include <memory>
+#include <cmath>
+#include <numeric>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "snapshot_wrapper.hpp"
+
+// shouldn't change things (but who knows ?)
+constexpr int g_vec_size = 10;
+
+/// the object stored inside
+struct MyClass
+{
+	int a;
+	float b;
+	std::vector<int> v;
+
+	MyClass(){}
+	MyClass( int aa, float bb ) : a(aa), b(bb) {}
+	MyClass( int aa): a(aa) {}
+	MyClass( const MyClass& other ) // copy constructor
+	{
+		a = other.a;
+		b = other.b;
+		v = other.v;
+	}
+	MyClass& operator=( int x )
+	{
+		assert( x==0 );
+		return *this;
+	}
+
+	MyClass& operator += ( const MyClass& x )
+	{
+		return *this;
+	}
+/// operator for a = b + c
+	const MyClass& operator + ( const MyClass& c ) const
+	{
+		return *this;
+	}
+};
+
+/// Value of the elements created by \c createTriplets()
+MyClass makeObject()
+{
+	MyClass object{ 5, 1.2 };
+	object.v.resize( g_vec_size );
+	return object;
+}
+
+/// a wrapper over Eigen Sparse Matrix, adds a std::set of linearized positions, protected by a reader/writer lock
+template<typename T>
+struct LockedSMWrapper
+{
+	std::set<int64_t>               _idx_set;
+	Eigen::SparseMatrix<T>          _data;
+	mutable std::shared_timed_mutex _mutex;
+
+	LockedSMWrapper( int r, int c ): _data(r,c)
+	{}
+
+	bool isNull( int r, int c ) const
+	{
+		std::shared_lock<std::shared_timed_mutex> lock( _mutex );
+		int64_t idx = static_cast<int64_t>(r) * _data.cols() + c;
+		return _idx_set.find( idx ) == _idx_set.cend();
+	}
+/// Rebuild in place: readers are blocked until it is done
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie )
+	{
+		std::unique_lock<std::shared_timed_mutex> lock( _mutex );
+		_data.setFromTriplets( ib, ie );
+		_idx_set.clear();
+		for( auto it = ib;it != ie; ++it )
+			_idx_set.insert( static_cast<int64_t>( it->row() ) * _data.cols() + it->col() );
+	}
+};
+
+/// Histogram of latencies, 8 buckets per power of 2 (so percentiles are given with a 12% precision)
+struct LatencyHisto
+{
+	std::vector<size_t> _buckets = std::vector<size_t>( 64*8, 0 );
+	size_t              _nb = 0;
+	uint64_t            _max = 0;
+
+	void add( uint64_t ns )
+	{
+		_max = std::max( _max, ns );
+		int k = 0;
+		while( k < 63 && ( ns >> (k+1) ) )
+			k++;
+		int sub = k < 3 ? ( ns << (3-k) ) & 7 : ( ns >> (k-3) ) & 7;
+		_buckets[k*8+sub]++;
+		_nb++;
+	}
+	void merge( const LatencyHisto& other )
+	{
+		for( size_t i=0; i<_buckets.size(); i++ )
+			_buckets[i] += other._buckets[i];
+		_nb += other._nb;
+		_max = std::max( _max, other._max );
+	}
+/// Returns the upper bound of the bucket holding the \c p percentile
+	double percentile( double p ) const
+	{
+		size_t target = p / 100. * _nb;
+		size_t sum = 0;
+		for( size_t i=0; i<_buckets.size(); i++ )
+		{
+			sum += _buckets[i];
+			if( sum > target )
+				return std::ldexp( 1. + ( i%8 + 1 ) / 8., i/8 );
+		}
+		return 0.;
+	}
+};
+
+/// Runs \c nbReaders threads doing random queries, while the main thread calls \c rebuild() in a loop
+/**
+\c makeQuery is called in each reader thread and must return a functor \c f(r,c) returning true if the element is null
+*/
+template<typename MakeQuery, typename Rebuild>
+void
+runBenchmark( const char* name, size_t matDim, int nbReaders, int durationMs, MakeQuery makeQuery, Rebuild rebuild )
+{
+	std::atomic<bool> stop( false );
+	std::vector<LatencyHisto> histos( nbReaders );
+	std::vector<size_t>       nbFound( nbReaders, 0 );
+	std::vector<std::thread>  readers;
+
+	for( int t=0; t<nbReaders; t++ )
+		readers.push_back( std::thread( [&,t]()
+		{
+			auto query = makeQuery();
+			LatencyHisto histo; // local, to avoid false sharing
+			size_t nb = 0;
+			std::minstd_rand gen( t+1 );
+			std::uniform_int_distribution<int> dist( 0, matDim-1 );
+			while( !stop.load( std::memory_order_relaxed ) )
+			{
+				int r = dist( gen );
+				int c = dist( gen );
+				auto t0 = MyClock::now();
+				bool n = query( r, c );
+				auto t1 = MyClock::now();
+				histo.add( std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() );
+				nb += !n;
+			}
+			histos[t] = histo;
+			nbFound[t] = nb;
+		} ) );
+
+	size_t nbRebuilds = 0;
+	Timing timing;
+	auto tEnd = MyClock::now() + std::chrono::milliseconds( durationMs );
+	while( MyClock::now() < tEnd )
+		rebuild( nbRebuilds++ );
+	stop = true;
+	for( auto& th: readers )
+		th.join();
+	auto duration = timing.getDuration();
+
+	LatencyHisto all;
+	for( const auto& h: histos )
+		all.merge( h );
+	std::cout << name << ": rebuilds=" << nbRebuilds
+		<< ", queries/s=" << 1000. * all._nb / duration
+		<< ", p50=" << all.percentile( 50 ) << " ns"
+		<< ", p99=" << all.percentile( 99 ) << " ns"
+		<< ", p99.9=" << all.percentile( 99.9 ) << " ns"
+		<< ", max=" << all._max / 1000 << " us"
+		<< " (found " << std::accumulate( nbFound.begin(), nbFound.end(), size_t(0) ) << ")\n";
+}
+
+/// see eigen_test_7.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+	size_t matDim = 10000;
+	if( argc>1 )
+		matDim = static_cast<size_t>( std::atoi( argv[1] ) );
+	size_t nbValues = 200000;
+	if( argc>2 )
+		nbValues = static_cast<size_t>( std::atoi( argv[2] ) );
+	int nbReaders = 3;
+	if( argc>3 )
+		nbReaders = std::atoi( argv[3] );
+	int durationMs = 2000;
+	if( argc>4 )
+		durationMs = std::atoi( argv[4] );
+
+	std::cout << "- matrix " << matDim << " x " << matDim << ", " << nbValues << " values, "
+		<< nbReaders << " readers, " << durationMs << " ms per run\n";
+
+// two sets of values, used alternately by the rebuilds
+	std::vector<std::vector<Eigen::Triplet<MyClass>>> tripletLists;
+	tripletLists.push_back( createTriplets( matDim, nbValues, makeObject ) );
+	tripletLists.push_back( createTriplets( matDim, nbValues, makeObject ) );
+
+	{
+		LockedSMWrapper<MyClass> mat( matDim, matDim );
+		mat.setFromTriplets( tripletLists[0].begin(), tripletLists[0].end() );
+		runBenchmark(
+			"locked  ", matDim, nbReaders, durationMs,
+			[&](){ return [&]( int r, int c ){ return mat.isNull( r, c ); }; },
+			[&]( size_t i ){ const auto& tl = tripletLists[i%2]; mat.setFromTriplets( tl.begin(), tl.end() ); }
+		);
+	}
+	{
+		SnapshotSMWrapper<MyClass> mat( matDim, matDim );
+		mat.setFromTriplets( tripletLists[0].begin(), tripletLists[0].end() );
+		runBenchmark(
+			"snapshot", matDim, nbReaders, durationMs,
+			[&]()
+			{
+				auto reader = std::make_shared<SnapshotSMWrapper<MyClass>::Reader>( mat ); // one per thread
+				return [reader]( int r, int c ){ return reader->isNull( r, c ); };
+			},
+			[&]( size_t i ){ const auto& tl = tripletLists[i%2]; mat.setFromTriplets( tl.begin(), tl.end() ); }
+		);
+	}
+}
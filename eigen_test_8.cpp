@@ -0,0 +1,223 @@
+
+/**
+\file eigen_test_8.cpp
+\brief Contention test of the concurrent presence indexes (see concurrent_presence.hpp)
+
+1 - For each index (std::set with a single lock, sharded hash sets, lock-free table), and for each nb of writer
+and reader threads: writers insert all the values (each one a part of them) while readers do random lookups.
+Prints insertions/s and lookups/s.
+
+2 - Fill of the wrapper: \c insertElem() from several threads, and parallel \c setFromTriplets(),
+compared with the serial fill of a \c std::set wrapper.
+
+Arguments:
+-# size of matrix n (matrix will be n x n ). Default is 10000
+-# nb of non-null values in the matrix. Default is 1000000
+-# max nb of writer threads (tests 1, 2, 4, ... up to this). Default is 8
+-# max nb of reader threads (tests 0, 1, 2, 4, ... up to this). Default is 4
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <random>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "concurrent_presence.hpp"
+
+char g_sep = ';';
+
+// shouldn't change things (but who knows ?)
+constexpr int g_vec_size = 10;
+
+/// the object stored inside
+struct MyClass
+{
+	int a;
+	float b;
+	std::vector<int> v;
+
+	MyClass(){}
+	MyClass( int aa, float bb ) : a(aa), b(bb) {}
+	MyClass( int aa): a(aa) {}
+	MyClass( const MyClass& other ) // copy constructor
+	{
+		a = other.a;
+		b = other.b;
+		v = other.v;
+	}
+	MyClass& operator=( int x )
+	{
+		assert( x==0 );
+		return *this;
+	}
+
+	MyClass& operator += ( const MyClass& x )
+	{
+		return *this;
+	}
+/// operator for a = b + c
+	const MyClass& operator + ( const MyClass& c ) const
+	{
+		return *this;
+	}
+};
+
+/// Value of the elements created by \c createTriplets()
+MyClass makeObject()
+{
+	MyClass object{ 5, 1.2 };
+	object.v.resize( g_vec_size );
+	return object;
+}
+
+/// The current way: a std::set, with a lock so that it can be used by several threads
+struct MutexSetPresence
+{
+	std::set<int64_t>  _idx_set;
+	mutable std::mutex _mutex;
+	size_t             _cols;
+
+	MutexSetPresence( size_t /*rows*/, size_t cols, size_t /*nnz*/ ): _cols(cols)
+	{}
+	bool insert( int r, int c )
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		return _idx_set.insert( static_cast<int64_t>(r) * _cols + c ).second;
+	}
+	bool isNull( int r, int c ) const
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		return _idx_set.find( static_cast<int64_t>(r) * _cols + c ) == _idx_set.cend();
+	}
+};
+
+/// Runs \c nbWriters threads inserting the values of \c tripletList in a new index, while \c nbReaders threads do lookups
+template<typename Presence>
+void
+runContention( const char* name, size_t matDim, const std::vector<Eigen::Triplet<MyClass>>& tripletList, int nbWriters, int nbReaders )
+{
+	Presence presence( matDim, matDim, tripletList.size() );
+	std::atomic<int>    nbWritersDone( 0 );
+	std::atomic<size_t> nbLookups( 0 );
+	std::atomic<size_t> nbFound( 0 );
+	std::vector<std::thread> threads;
+
+	Timing timing;
+	for( int t=0; t<nbReaders; t++ )
+		threads.push_back( std::thread( [&,t]()
+		{
+			std::minstd_rand gen( t+1 );
+			std::uniform_int_distribution<int> dist( 0, matDim-1 );
+			size_t n = 0, nb = 0;
+			while( nbWritersDone.load( std::memory_order_relaxed ) < nbWriters )
+			{
+				nb += !presence.isNull( dist(gen), dist(gen) );
+				n++;
+			}
+			nbLookups += n;
+			nbFound += nb;
+		} ) );
+	size_t nb = tripletList.size();
+	for( int t=0; t<nbWriters; t++ )
+		threads.push_back( std::thread( [&,t]()
+		{
+			for( size_t i = nb * t / nbWriters; i < nb * (t+1) / nbWriters; i++ )
+				presence.insert( tripletList[i].row(), tripletList[i].col() );
+			nbWritersDone++;
+		} ) );
+	for( auto& th: threads )
+		th.join();
+	auto durationNs = timing.getDurationNs();
+
+	std::cout << name << g_sep << nbWriters << g_sep << nbReaders
+		<< g_sep << 1000. * nb / durationNs
+		<< g_sep << 1000. * nbLookups / durationNs << '\n';
+}
+
+/// Runs all the combinations of nb of writers and readers for an index
+template<typename Presence>
+void
+runAllContention( const char* name, size_t matDim, const std::vector<Eigen::Triplet<MyClass>>& tripletList, int maxWriters, int maxReaders )
+{
+	for( int nbReaders=0; nbReaders<=maxReaders; nbReaders = nbReaders ? nbReaders*2 : 1 )
+		for( int nbWriters=1; nbWriters<=maxWriters; nbWriters *= 2 )
+			runContention<Presence>( name, matDim, tripletList, nbWriters, nbReaders );
+}
+
+/// Fills the wrapper with \c insertElem() from \c nbWriters threads, then flushes
+template<typename Presence>
+void
+fillWrapper( const char* name, size_t matDim, const std::vector<Eigen::Triplet<MyClass>>& tripletList, int nbWriters )
+{
+	ConcurrentSMWrapper<MyClass,Presence> mat( matDim, matDim, tripletList.size() );
+	size_t nb = tripletList.size();
+	{
+		std::cout << " - " << name << ", insertElem() from " << nbWriters << " threads + flush()\n";
+		Timing timing;
+		std::vector<std::thread> threads;
+		for( int t=0; t<nbWriters; t++ )
+			threads.push_back( std::thread( [&,t]()
+			{
+				for( size_t i = nb * t / nbWriters; i < nb * (t+1) / nbWriters; i++ )
+					mat.insertElem( tripletList[i].row(), tripletList[i].col(), tripletList[i].value() );
+			} ) );
+		for( auto& th: threads )
+			th.join();
+		mat.flush();
+		timing.PrintDuration();
+	}
+	ConcurrentSMWrapper<MyClass,Presence> mat2( matDim, matDim, tripletList.size() );
+	{
+		std::cout << " - " << name << ", setFromTriplets() with " << nbWriters << " threads\n";
+		Timing timing;
+		mat2.setFromTriplets( tripletList.begin(), tripletList.end(), nbWriters );
+		timing.PrintDuration();
+	}
+	if( mat.isNull( tripletList[0].row(), tripletList[0].col() ) || mat2._data.nonZeros() != mat._data.nonZeros() )
+		std::cerr << "Error: wrong fill\n";
+}
+
+/// see eigen_test_8.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+	size_t matDim = 10000;
+	if( argc>1 )
+		matDim = static_cast<size_t>( std::atoi( argv[1] ) );
+	size_t nbValues = 1000000;
+	if( argc>2 )
+		nbValues = static_cast<size_t>( std::atoi( argv[2] ) );
+	int maxWriters = 8;
+	if( argc>3 )
+		maxWriters = std::atoi( argv[3] );
+	int maxReaders = 4;
+	if( argc>4 )
+		maxReaders = std::atoi( argv[4] );
+
+	std::cout << "- matrix " << matDim << " x " << matDim << ", " << nbValues << " values, "
+		<< std::thread::hardware_concurrency() << " hardware threads\n";
+
+	auto tripletList = createTriplets( matDim, nbValues, makeObject );
+
+	std::cout << "\n1 - contention\n";
+	std::cout << "# index;nb writers;nb readers;M inserts/s;M lookups/s\n";
+	runAllContention<MutexSetPresence>(    "set+mutex", matDim, tripletList, maxWriters, maxReaders );
+	runAllContention<ShardedPresence<64>>( "sharded",   matDim, tripletList, maxWriters, maxReaders );
+	runAllContention<LockFreePresence>(    "lock-free", matDim, tripletList, maxWriters, maxReaders );
+
+	std::cout << "\n2 - fill wrapper\n";
+	{
+		std::cout << " - std::set wrapper, serial\n";
+		EigenSMWrapper<MyClass> mat( matDim, matDim );
+		Timing timing;
+		mat.setFromTriplets( tripletList.begin(), tripletList.end() );
+		timing.PrintDuration();
+	}
+	fillWrapper<ShardedPresence<64>>( "sharded",   matDim, tripletList, maxWriters );
+	fillWrapper<LockFreePresence>(    "lock-free", matDim, tripletList, maxWriters );
+}
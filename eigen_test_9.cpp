@@ -0,0 +1,204 @@
+
+/**
+\file eigen_test_9.cpp
+\brief Speed test of rectangular window queries (see window_query.hpp), for growing window sizes
+
+For each window size w (random w x w windows), prints the mean duration of:
+- counting by naive iteration (all the values of each column of the window are checked)
+- counting with a binary search in each column
+- counting with the tile summary
+- enumerating the values, naive and with binary search
+
+Arguments:
+-# size of matrix n (matrix will be n x n ). Default is 10000
+-# nb of non-null values in the matrix. Default is 1000000
+-# nb of queries for each window size. Default is 1000
+*/
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <iostream>
+#include "timing.hpp"
+#include "bench_common.hpp"
+#include "window_query.hpp"
+
+int g_tab_val[] = { 1, 2, 5 };
+char g_sep = ';';
+
+// shouldn't change things (but who knows ?)
+constexpr int g_vec_size = 10;
+
+/// the object stored inside
+struct MyClass
+{
+	int a;
+	float b;
+	std::vector<int> v;
+
+	MyClass(){}
+	MyClass( int aa, float bb ) : a(aa), b(bb) {}
+	MyClass( int aa): a(aa) {}
+	MyClass( const MyClass& other ) // copy constructor
+	{
+		a = other.a;
+		b = other.b;
+		v = other.v;
+	}
+	MyClass& operator=( int x )
+	{
+		assert( x==0 );
+		return *this;
+	}
+
+	MyClass& operator += ( const MyClass& x )
+	{
+		return *this;
+	}
+/// operator for a = b + c
+	const MyClass& operator + ( const MyClass& c ) const
+	{
+		return *this;
+	}
+};
+
+/// Value of the elements created by \c createTriplets()
+MyClass makeObject()
+{
+	MyClass object{ 5, 1.2 };
+	object.v.resize( g_vec_size );
+	return object;
+}
+
+/// the wrapper over Eigen Sparse Matrix (see bench_common.hpp), with window queries
+template<typename T>
+struct EigenSMWrapper_window: public EigenSMWrapper<T>
+{
+	WindowCountSummary _summary;
+	bool               _hasSummary = false;
+
+	EigenSMWrapper_window( int r, int c ): EigenSMWrapper<T>(r,c)
+	{}
+
+/// \c withSummary: also build the tile summary, for faster \c windowCount() on large windows
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie, bool withSummary=false )
+	{
+		EigenSMWrapper<T>::setFromTriplets( ib, ie );
+		_hasSummary = withSummary;
+		if( withSummary )
+			_summary.build( this->_data );
+	}
+/// Calls \c f(row,col,value) for each value in rows [r0,r1) x cols [c0,c1)
+	template<typename Func>
+	void forEachInWindow( int r0, int r1, int c0, int c1, Func f ) const
+	{
+		::forEachInWindow( this->_data, r0, r1, c0, c1, f );
+	}
+/// Nb of values in rows [r0,r1) x cols [c0,c1)
+	size_t windowCount( int r0, int r1, int c0, int c1 ) const
+	{
+		if( _hasSummary )
+			return _summary.count( r0, r1, c0, c1 );
+		return countInWindow( this->_data, r0, r1, c0, c1 );
+	}
+};
+
+/// Naive count: iterates over all the values of the columns of the window
+template<typename T>
+size_t
+naiveCount( const Eigen::SparseMatrix<T>& mat, int r0, int r1, int c0, int c1 )
+{
+	size_t n = 0;
+	for( int c=c0; c<c1; c++ )
+		for( typename Eigen::SparseMatrix<T>::InnerIterator it(mat, c); it; ++it )
+			if( it.row() >= r0 && it.row() < r1 )
+				n++;
+	return n;
+}
+
+/// Returns the mean duration of a query, in ns. \c query(r0,r1,c0,c1) must return a nb of values, whose sum is stored in \c sum
+template<typename Query>
+double
+measureWindows( Query query, const std::vector<std::pair<int,int>>& corners, int w, size_t& sum )
+{
+	sum = 0;
+	Timing timing;
+	for( const auto& p: corners )
+		sum += query( p.first, p.first + w, p.second, p.second + w );
+	double t = 1.0 * timing.getDurationNs() / corners.size();
+	g_nbFound = g_nbFound + sum;
+	return t;
+}
+
+/// see eigen_test_9.cpp
+int main( int argc, const char** argv )
+{
+	std::srand(time(0));
+	std::cout << "# Eigen version: " << EIGEN_WORLD_VERSION << '.' << EIGEN_MAJOR_VERSION << '.' << EIGEN_MINOR_VERSION << '\n';
+	size_t matDim = 10000;
+	if( argc>1 )
+		matDim = static_cast<size_t>( std::atoi( argv[1] ) );
+	size_t nbValues = 1000000;
+	if( argc>2 )
+		nbValues = static_cast<size_t>( std::atoi( argv[2] ) );
+	size_t nbQueries = 1000;
+	if( argc>3 )
+		nbQueries = static_cast<size_t>( std::atoi( argv[3] ) );
+
+	std::cout << "# matrix " << matDim << " x " << matDim << ", " << nbValues << " values, " << nbQueries << " queries per size\n";
+
+	EigenSMWrapper_window<MyClass> mat( matDim, matDim );
+	{
+		auto tripletList = createTriplets( matDim, nbValues, makeObject );
+		Timing timing;
+		mat.setFromTriplets( tripletList.begin(), tripletList.end(), true );
+		std::cout << "# fill + summary: " << timing.getDuration() << " ms, summary uses "
+			<< mat._summary.memoryBytes() / 1024 << " kB\n";
+	}
+
+	std::cout << "# window;naive_count_ns;bsearch_count_ns;summary_count_ns;naive_enum_ns;enum_ns;mean count\n";
+	size_t pow1 = 1;
+	for( int j=0; ; j++ )
+	{
+		if( j && !(j%3) )
+			pow1 *= 10;
+		int w = g_tab_val[j%3] * pow1;
+		if( w > static_cast<int>( matDim ) )
+			break;
+
+		std::vector<std::pair<int,int>> corners( nbQueries );
+		for( auto& p: corners )
+		{
+			p.first  = 1.0*rand()/RAND_MAX * ( matDim - w );
+			p.second = 1.0*rand()/RAND_MAX * ( matDim - w );
+		}
+		size_t s1, s2, s3, s4, s5;
+		double t1 = measureWindows( [&]( int r0, int r1, int c0, int c1 ){ return naiveCount( mat._data, r0, r1, c0, c1 ); }, corners, w, s1 );
+		double t2 = measureWindows( [&]( int r0, int r1, int c0, int c1 ){ return countInWindow( mat._data, r0, r1, c0, c1 ); }, corners, w, s2 );
+		double t3 = measureWindows( [&]( int r0, int r1, int c0, int c1 ){ return mat.windowCount( r0, r1, c0, c1 ); }, corners, w, s3 );
+		double t4 = measureWindows(
+			[&]( int r0, int r1, int c0, int c1 )
+			{
+				size_t n = 0;
+				for( int c=c0; c<c1; c++ )
+					for( Eigen::SparseMatrix<MyClass>::InnerIterator it(mat._data, c); it; ++it )
+						if( it.row() >= r0 && it.row() < r1 )
+							n += it.value().a;
+				return n;
+			},
+			corners, w, s4 );
+		double t5 = measureWindows(
+			[&]( int r0, int r1, int c0, int c1 )
+			{
+				size_t n = 0;
+				mat.forEachInWindow( r0, r1, c0, c1, [&n]( int, int, const MyClass& v ){ n += v.a; } );
+				return n;
+			},
+			corners, w, s5 );
+		if( s1 != s2 || s1 != s3 || s4 != s5 )
+			std::cerr << "Error: different results " << s1 << ' ' << s2 << ' ' << s3 << ' ' << s4 << ' ' << s5 << '\n';
+
+		std::cout << w << g_sep << t1 << g_sep << t2 << g_sep << t3 << g_sep << t4 << g_sep << t5
+			<< g_sep << 1. * s1 / nbQueries << std::endl;
+	}
+}
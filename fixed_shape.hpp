@@ -0,0 +1,256 @@
+/**
+\file fixed_shape.hpp
+\brief Matrix shape known at compile time or at run time, and presence indexes specialized on it
+
+The presence indexes compute a key from (row, col) at each lookup. With a runtime shape (\c RuntimeShape), this is
+a 64 bits multiplication by a value loaded from memory. With \c FixedShape<Rows,Cols,Index>, everything is \c constexpr:
+- the key is packed as (row << ColBits) | col, with \c ColBits the nb of bits needed for \c Cols
+- it is stored on \c Index (for example 32 bits, if RowBits + ColBits <= 32), so a hash table uses half the memory
+- the bitmap address is row * Cols + col, with \c Cols a constant (the compiler uses shifts and adds)
+
+\c ShapedHash and \c ShapedBitmap take the shape as template parameter, so the same code is instantiated with both,
+and the difference measured is only due to the compile-time specialization (see eigen_test_15.cpp).
+*/
+
+#ifndef FIXED_SHAPE_HPP
+#define FIXED_SHAPE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include "hash_util.hpp"
+
+/// Nb of bits needed to store the values in [0,n)
+constexpr int bitWidth( uint64_t n )
+{
+	return n <= 1 ? 0 : 1 + bitWidth( ( n + 1 ) >> 1 );
+}
+
+static_assert( bitWidth(1) == 0 && bitWidth(2) == 1 && bitWidth(1000) == 10 && bitWidth(1024) == 10 && bitWidth(1025) == 11, "bitWidth" );
+
+//-----------------------------------------------------------------------------------
+/// Shape of the matrix given at run time: 64 bits linearized key (same as presence_index.hpp)
+struct RuntimeShape
+{
+	typedef uint64_t Key;
+
+	size_t _rows;
+	size_t _cols;
+
+	RuntimeShape( size_t r, size_t c ): _rows(r), _cols(c)
+	{}
+
+	size_t rows() const { return _rows; }
+	size_t cols() const { return _cols; }
+/// Key used by hash tables
+	Key key( int r, int c ) const
+	{
+		return static_cast<Key>(r) * _cols + c;
+	}
+/// Position in a dense bitmap
+	size_t linear( int r, int c ) const
+	{
+		return static_cast<size_t>(r) * _cols + c;
+	}
+	static const char* name() { return "runtime"; }
+};
+
+//-----------------------------------------------------------------------------------
+/// Shape of the matrix given at compile time: key packed on \c Index
+template<size_t Rows, size_t Cols, typename Index=uint32_t>
+struct FixedShape
+{
+	typedef Index Key;
+
+	static constexpr int RowBits = bitWidth( Rows );
+	static constexpr int ColBits = bitWidth( Cols );
+
+	static_assert( std::is_unsigned<Index>::value, "Index must be unsigned" );
+	static_assert( RowBits + ColBits <= std::numeric_limits<Index>::digits, "Index is too small for this shape" );
+	static_assert( ( ( static_cast<uint64_t>( Rows - 1 ) << ColBits ) | ( Cols - 1 ) ) < std::numeric_limits<Index>::max() - 1,
+		"the largest key must be below the max of Index - 1 (key + 1 is stored, and the max is the tombstone of ShapedHash)" );
+
+	FixedShape() {}
+/// To be used in place of a \c RuntimeShape: checks that the sizes are the right ones
+	FixedShape( size_t r, size_t c )
+	{
+		assert( r == Rows && c == Cols );
+		(void)r; (void)c;
+	}
+
+	static constexpr size_t rows() { return Rows; }
+	static constexpr size_t cols() { return Cols; }
+	static constexpr Key key( int r, int c )
+	{
+		return static_cast<Key>( ( static_cast<Key>(r) << ColBits ) | static_cast<Key>(c) );
+	}
+	static constexpr size_t linear( int r, int c )
+	{
+		return static_cast<size_t>(r) * Cols + c;
+	}
+	static const char* name() { return "fixed"; }
+};
+
+//-----------------------------------------------------------------------------------
+/// Open-addressing hash set (linear probing) of the keys of \c Shape
+/**
+Same layout as \c LockFreePresence (concurrent_presence.hpp), without atomics: a slot holds key + 1, 0 means empty,
+and the max of \c Key is a tombstone (removed key), that is skipped by lookups and reused by \c insert().
+Capacity is fixed when created (twice the nb of values, rounded to a power of 2). When the used slots (values and
+tombstones) reach 3/4 of it, the tombstones are removed by reinserting the values, so that lookups always end on an empty slot.
+*/
+template<typename Shape>
+struct ShapedHash
+{
+	typedef typename Shape::Key Key;
+
+	Shape            _shape;
+	std::vector<Key> _slots;
+	size_t           _mask = 0;
+	size_t           _size = 0;
+	size_t           _used = 0;  ///< nb of slots not empty: values + tombstones
+
+	static constexpr Key g_tombstone = std::numeric_limits<Key>::max();
+
+	ShapedHash( size_t rows, size_t cols ): _shape( rows, cols )
+	{}
+
+	void init( size_t nnz )
+	{
+		size_t capacity = 16;
+		while( capacity < 2*nnz )
+			capacity *= 2;
+		_slots.assign( capacity, 0 );
+		_mask = capacity - 1;
+		_size = 0;
+		_used = 0;
+	}
+/// Returns false if already present, throws if the table is full
+	bool insert( int r, int c )
+	{
+		Key k = _shape.key( r, c ) + 1;
+		size_t i = hashPosition( k ) & _mask;
+		size_t slot = _slots.size(); // first tombstone, or else the empty slot that ends the probing
+		for( size_t n=0; n<=_mask; n++, i = (i+1) & _mask )
+		{
+			Key cur = _slots[i];
+			if( cur == k )
+				return false;
+			if( cur == g_tombstone && slot == _slots.size() )
+				slot = i;
+			if( cur == 0 )
+			{
+				if( slot == _slots.size() )
+				{
+					if( _used >= _slots.size() / 4 * 3 && _used > _size )
+					{
+						removeTombstones();
+						return insert( r, c );
+					}
+					slot = i;
+					_used++;
+				}
+				break;
+			}
+		}
+		if( slot == _slots.size() )
+			throw std::runtime_error( "ShapedHash: table is full" );
+		_slots[slot] = k;
+		_size++;
+		return true;
+	}
+/// Returns false if not present
+	bool erase( int r, int c )
+	{
+		Key k = _shape.key( r, c ) + 1;
+		size_t i = hashPosition( k ) & _mask;
+		for( size_t n=0; n<=_mask; n++, i = (i+1) & _mask )
+		{
+			if( _slots[i] == 0 )
+				return false;
+			if( _slots[i] == k )
+			{
+				_slots[i] = g_tombstone;
+				_size--;
+				return true;
+			}
+		}
+		return false;
+	}
+	bool isNull( int r, int c ) const
+	{
+		Key k = _shape.key( r, c ) + 1;
+		size_t i = hashPosition( k ) & _mask;
+		while( true )
+		{
+			Key cur = _slots[i];
+			if( cur == k )
+				return false;
+			if( cur == 0 )
+				return true;
+			i = (i+1) & _mask;
+		}
+	}
+	size_t size() const
+	{
+		return _size;
+	}
+	size_t memoryBytes() const
+	{
+		return _slots.capacity() * sizeof(Key);
+	}
+
+private:
+/// Reinserts the values in a cleared table
+	void removeTombstones()
+	{
+		std::vector<Key> keys;
+		keys.reserve( _size );
+		for( Key cur: _slots )
+			if( cur != 0 && cur != g_tombstone )
+				keys.push_back( cur );
+		std::fill( _slots.begin(), _slots.end(), Key(0) );
+		for( Key k: keys )
+		{
+			size_t i = hashPosition( k ) & _mask;
+			while( _slots[i] != 0 )
+				i = (i+1) & _mask;
+			_slots[i] = k;
+		}
+		_used = _size;
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// Dense bitmap, addressed by \c Shape::linear()
+template<typename Shape>
+struct ShapedBitmap
+{
+	Shape                 _shape;
+	std::vector<uint64_t> _bits;
+
+	ShapedBitmap( size_t rows, size_t cols ): _shape( rows, cols ), _bits( ( rows * cols + 63 ) / 64, 0 )
+	{}
+
+	void insert( int r, int c )
+	{
+		size_t k = _shape.linear( r, c );
+		_bits[k>>6] |= uint64_t(1) << (k&63);
+	}
+	bool isNull( int r, int c ) const
+	{
+		size_t k = _shape.linear( r, c );
+		return !( ( _bits[k>>6] >> (k&63) ) & 1 );
+	}
+	size_t memoryBytes() const
+	{
+		return _bits.capacity() * sizeof(uint64_t);
+	}
+};
+
+#endif // FIXED_SHAPE_HPP
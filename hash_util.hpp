@@ -0,0 +1,22 @@
+/**
+\file hash_util.hpp
+\brief Hash function for the linearized positions, shared by the hash-based presence indexes
+*/
+
+#ifndef HASH_UTIL_HPP
+#define HASH_UTIL_HPP
+
+#include <cstdint>
+
+/// Mixes the bits of a position (finalizer of MurmurHash3), so that neighbours go to different shards/slots
+inline uint64_t hashPosition( uint64_t k )
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+#endif // HASH_UTIL_HPP
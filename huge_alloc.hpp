@@ -0,0 +1,332 @@
+/**
+\file huge_alloc.hpp
+\brief Allocation of large arrays with huge pages and NUMA placement, and a read-only CSC matrix / presence bitmap using them
+
+With a few GB of inner indices, values and presence bitmap, random probes touch a different 4 kB page each time,
+so nearly every probe misses the dTLB. With 2 MB pages, the same arrays need 512 times fewer TLB entries.
+On a multi-socket machine, pages are by default placed on the node of the thread that first writes them,
+so after a serial fill, all the arrays are on a single node.
+
+\c AllocPolicy selects, for an array:
+- huge pages: none, transparent (\c madvise(MADV_HUGEPAGE), the region is aligned on 2 MB so that it can be fully
+backed), or explicit (\c mmap(MAP_HUGETLB), needs pages reserved in \c /proc/sys/vm/nr_hugepages; falls back to transparent)
+- NUMA placement: default, interleaved on all the nodes (\c mbind(MPOL_INTERLEAVE), done with the syscall so that
+there is no need to link with libnuma), or first-touch: the pages are written first by a parallel fill
+on a \c ThreadPool, so that each part of the array goes to the node of the thread that will mostly use it
+(assuming the OS keeps the threads on the same node)
+
+Arrays are allocated with \c mmap, so they hold only trivially copyable types, and are zero-initialized.
+On non-Linux systems, policies are ignored and the arrays are allocated with \c calloc.
+*/
+
+#ifndef HUGE_ALLOC_HPP
+#define HUGE_ALLOC_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <new>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include "thread_pool.hpp"
+#include "parallel_traversal.hpp"
+
+#ifdef __linux__
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+	#include <linux/mempolicy.h>
+#endif
+
+/// Size of a huge page (x86-64 and most ARM64 configurations)
+constexpr size_t g_huge_page_size = size_t(2) << 20;
+
+enum HugePagePolicy
+{
+	HP_NONE,
+	HP_TRANSPARENT,
+	HP_EXPLICIT
+};
+
+enum NumaPolicy
+{
+	NP_DEFAULT,
+	NP_INTERLEAVE,
+	NP_FIRST_TOUCH
+};
+
+/// How to allocate the large arrays of a matrix
+struct AllocPolicy
+{
+	HugePagePolicy huge = HP_NONE;
+	NumaPolicy     numa = NP_DEFAULT;
+
+	AllocPolicy() {}
+	AllocPolicy( HugePagePolicy h, NumaPolicy n ): huge(h), numa(n) {}
+};
+
+inline const char* getHugePagePolicyName( HugePagePolicy hp )
+{
+	static const char* names[] = { "none", "transparent", "explicit" };
+	return names[hp];
+}
+
+inline const char* getNumaPolicyName( NumaPolicy np )
+{
+	static const char* names[] = { "default", "interleave", "first-touch" };
+	return names[np];
+}
+
+/// Mask of the online NUMA nodes (read from /sys, nodes above 63 are ignored). Returns 1 (node 0) if unknown
+inline unsigned long getNumaNodeMask()
+{
+	std::ifstream f( "/sys/devices/system/node/online" );
+	std::string s;
+	if( !( f >> s ) )
+		return 1;
+	unsigned long mask = 0;
+	size_t pos = 0;
+	while( pos < s.size() ) // format is for example "0-1,4"
+	{
+		size_t end = s.find( ',', pos );
+		if( end == std::string::npos )
+			end = s.size();
+		std::string range = s.substr( pos, end - pos );
+		size_t dash = range.find( '-' );
+		int first = std::atoi( range.c_str() );
+		int last  = dash == std::string::npos ? first : std::atoi( range.c_str() + dash + 1 );
+		for( int n=first; n<=last && n<64; n++ )
+			mask |= 1UL << n;
+		pos = end + 1;
+	}
+	return mask ? mask : 1;
+}
+
+/// Nb of bytes of the process currently backed by transparent huge pages (from /proc/self/smaps_rollup, 0 if not available)
+inline size_t getAnonHugeBytes()
+{
+	std::ifstream f( "/proc/self/smaps_rollup" );
+	std::string key;
+	size_t kb;
+	while( f >> key )
+	{
+		if( key == "AnonHugePages:" && f >> kb )
+			return kb * 1024;
+		f.ignore( 1000, '\n' );
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------------
+/// Fixed size array allocated according to an \c AllocPolicy
+template<typename T>
+struct HugeArray
+{
+	static_assert( std::is_trivially_copyable<T>::value, "HugeArray only holds trivially copyable types" );
+
+	T*             _data = nullptr;
+	size_t         _size = 0;
+	void*          _base = nullptr;     ///< start of the mapping (may be before \c _data, because of the alignment)
+	size_t         _mapped = 0;         ///< length of the mapping
+	HugePagePolicy _huge = HP_NONE;     ///< what was obtained (may differ from what was asked)
+	bool           _interleaved = false;
+
+	HugeArray() {}
+	~HugeArray()
+	{
+		release();
+	}
+	HugeArray( const HugeArray& ) = delete;
+	HugeArray& operator = ( const HugeArray& ) = delete;
+
+	size_t size() const { return _size; }
+	T*       data()       { return _data; }
+	const T* data() const { return _data; }
+	T&       operator [] ( size_t i )       { return _data[i]; }
+	const T& operator [] ( size_t i ) const { return _data[i]; }
+
+	HugePagePolicy getHugePages() const { return _huge; }
+	bool isInterleaved() const { return _interleaved; }
+	size_t memoryBytes() const { return _mapped; }
+
+/// Allocates \c n zeroed elements (previous content is released)
+	void allocate( size_t n, AllocPolicy policy )
+	{
+		release();
+		_size = n;
+		if( n == 0 )
+			return;
+		size_t bytes = n * sizeof(T);
+#ifdef __linux__
+		if( policy.huge == HP_EXPLICIT )
+		{
+			_mapped = ( bytes + g_huge_page_size - 1 ) / g_huge_page_size * g_huge_page_size;
+			_base = mmap( nullptr, _mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+			if( _base != MAP_FAILED )
+				_huge = HP_EXPLICIT;
+		}
+		if( _huge != HP_EXPLICIT )
+		{
+			size_t align = policy.huge == HP_NONE ? 0 : g_huge_page_size;
+			_mapped = ( bytes + 4095 ) / 4096 * 4096;
+			_base = mmap( nullptr, _mapped + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+			if( _base == MAP_FAILED )
+				throw std::bad_alloc();
+			if( align ) // unmap the unaligned head and the tail
+			{
+				char* p = static_cast<char*>( _base );
+				char* aligned = reinterpret_cast<char*>( ( reinterpret_cast<uintptr_t>( p ) + align - 1 ) & ~( align - 1 ) );
+				if( aligned != p )
+					munmap( p, aligned - p );
+				size_t tail = ( p + _mapped + align ) - ( aligned + _mapped );
+				if( tail )
+					munmap( aligned + _mapped, tail );
+				_base = aligned;
+				if( madvise( _base, _mapped, MADV_HUGEPAGE ) == 0 )
+					_huge = HP_TRANSPARENT;
+			}
+		}
+		if( policy.numa == NP_INTERLEAVE )
+		{
+			unsigned long mask = getNumaNodeMask();
+			_interleaved = syscall( SYS_mbind, _base, _mapped, MPOL_INTERLEAVE, &mask, sizeof(mask) * 8, 0 ) == 0;
+		}
+#else
+		_mapped = bytes;
+		_base = std::calloc( n, sizeof(T) );
+		if( !_base )
+			throw std::bad_alloc();
+#endif
+		_data = static_cast<T*>( _base );
+	}
+
+	void release()
+	{
+		if( _base )
+		{
+#ifdef __linux__
+			munmap( _base, _mapped );
+#else
+			std::free( _base );
+#endif
+		}
+		_data = nullptr;
+		_base = nullptr;
+		_size = 0;
+		_mapped = 0;
+		_huge = HP_NONE;
+		_interleaved = false;
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// Read-only copy of a compressed Eigen matrix (CSC), whose arrays are allocated with an \c AllocPolicy
+/**
+Eigen does not allow to choose the allocator of a \c SparseMatrix, so the arrays are copied.
+\c map() gives back the Eigen API (iterators, products, ...) on these arrays.
+*/
+template<typename T, typename StorageIndex=int>
+struct PagedCscMatrix
+{
+	typedef Eigen::Map<const Eigen::SparseMatrix<T,Eigen::ColMajor,StorageIndex>> ConstMap;
+
+	size_t                   _rows = 0;
+	size_t                   _cols = 0;
+	HugeArray<StorageIndex>  _outer;
+	HugeArray<StorageIndex>  _inner;
+	HugeArray<T>             _values;
+
+/// Copies \c mat. If \c pool is given, the copy is done in parallel, by chunks of the same nb of values (first-touch placement)
+	void build( const Eigen::SparseMatrix<T,Eigen::ColMajor,StorageIndex>& mat, AllocPolicy policy, ThreadPool* pool=nullptr )
+	{
+		assert( mat.isCompressed() );
+		_rows = mat.rows();
+		_cols = mat.cols();
+		_outer.allocate( mat.outerSize() + 1, policy );
+		_inner.allocate( mat.nonZeros(), policy );
+		_values.allocate( mat.nonZeros(), policy );
+
+		const StorageIndex* outer = mat.outerIndexPtr();
+		auto copyCols = [&]( int c0, int c1 )
+		{
+			std::copy( outer + c0, outer + c1, _outer.data() + c0 );
+			std::copy( mat.innerIndexPtr() + outer[c0], mat.innerIndexPtr() + outer[c1], _inner.data() + outer[c0] );
+			std::copy( mat.valuePtr()      + outer[c0], mat.valuePtr()      + outer[c1], _values.data() + outer[c0] );
+		};
+		if( pool )
+		{
+			auto bounds = partitionByNnz( outer, mat.outerSize(), g_nb_chunks );
+			pool->run( g_nb_chunks, [&]( int chunk ){ copyCols( bounds[chunk], bounds[chunk+1] ); } );
+		}
+		else
+			copyCols( 0, mat.outerSize() );
+		_outer[mat.outerSize()] = outer[mat.outerSize()];
+	}
+
+	size_t rows() const { return _rows; }
+	size_t cols() const { return _cols; }
+	size_t nonZeros() const { return _inner.size(); }
+
+/// Return true if element at \c row, \c col is empty (binary search in the column)
+	bool isNull( int r, int c ) const
+	{
+		const StorageIndex* first = _inner.data() + _outer[c];
+		const StorageIndex* last  = _inner.data() + _outer[c+1];
+		const StorageIndex* it = std::lower_bound( first, last, r );
+		return it == last || *it != r;
+	}
+
+	ConstMap map() const
+	{
+		return ConstMap( _rows, _cols, _inner.size(), _outer.data(), _inner.data(), _values.data() );
+	}
+
+	size_t memoryBytes() const
+	{
+		return _outer.memoryBytes() + _inner.memoryBytes() + _values.memoryBytes();
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// Dense presence bitmap (same as \c PresenceBitmap in presence_index.hpp), allocated with an \c AllocPolicy
+struct PagedBitmap
+{
+	HugeArray<uint64_t> _bits;
+	size_t              _cols = 0;
+
+/// If \c pool is given, the bitmap is cleared in parallel (first-touch placement)
+	void init( size_t rows, size_t cols, AllocPolicy policy, ThreadPool* pool=nullptr )
+	{
+		_cols = cols;
+		_bits.allocate( ( rows * cols + 63 ) / 64, policy );
+		if( pool )
+		{
+			size_t n = _bits.size();
+			pool->run( g_nb_chunks, [&]( int chunk )
+			{
+				std::fill( _bits.data() + n * chunk / g_nb_chunks, _bits.data() + n * (chunk+1) / g_nb_chunks, uint64_t(0) );
+			} );
+		}
+	}
+	void insert( int r, int c )
+	{
+		int64_t k = static_cast<int64_t>(r) * _cols + c;
+		_bits[k>>6] |= uint64_t(1) << (k&63);
+	}
+	bool isNull( int r, int c ) const
+	{
+		int64_t k = static_cast<int64_t>(r) * _cols + c;
+		return !( ( _bits[k>>6] >> (k&63) ) & 1 );
+	}
+	size_t memoryBytes() const
+	{
+		return _bits.memoryBytes();
+	}
+};
+
+#endif // HUGE_ALLOC_HPP
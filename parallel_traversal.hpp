@@ -0,0 +1,101 @@
+/**
+\file parallel_traversal.hpp
+\brief Traversal of all the values of a sparse matrix by a visitor, serial or parallel
+
+The columns are split in chunks holding about the same number of values (not the same number of columns),
+using the outer index array, that is already the cumulative count of values per column.
+The chunks are then processed by the threads of a \c ThreadPool.
+
+\c reduceNonZero() is deterministic: the matrix is always split in the same chunks (their number does not depend on
+the nb of threads), each chunk is reduced serially, and the partial results are combined in chunk order.
+So even non-associative operations (floating point sums) give the same result with any nb of threads.
+*/
+
+#ifndef PARALLEL_TRAVERSAL_HPP
+#define PARALLEL_TRAVERSAL_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include "thread_pool.hpp"
+
+/// Default nb of chunks: enough to balance the load with dynamic scheduling
+constexpr int g_nb_chunks = 256;
+
+/// Returns the \c nbChunks+1 bounds of column ranges, so that each range holds about nnz/nbChunks values
+template<typename StorageIndex>
+std::vector<int>
+partitionByNnz( const StorageIndex* outer, int outerSize, int nbChunks )
+{
+	std::vector<int> bounds( nbChunks+1, outerSize );
+	bounds[0] = 0;
+	double nnz = outer[outerSize] - outer[0];
+	for( int k=1; k<nbChunks; k++ )
+	{
+		StorageIndex target = outer[0] + static_cast<StorageIndex>( nnz * k / nbChunks );
+		bounds[k] = std::lower_bound( outer, outer + outerSize, target ) - outer;
+		bounds[k] = std::max( bounds[k], bounds[k-1] );
+	}
+	return bounds;
+}
+
+/// Calls \c visitor(row,col,value) for each value, serially (same as \c PrintMat() in eigen_test_1.cpp)
+template<typename T, typename Visitor>
+void
+forEachNonZero( const Eigen::SparseMatrix<T>& mat, Visitor visitor )
+{
+	for( int k=0; k<mat.outerSize(); ++k )
+		for( typename Eigen::SparseMatrix<T>::InnerIterator it(mat,k); it; ++it )
+			visitor( it.row(), it.col(), it.value() );
+}
+
+/// Calls \c visitor(row,col,value) for each value, on the threads of \c pool (the visitor must be thread-safe)
+template<typename T, typename Visitor>
+void
+forEachNonZero( const Eigen::SparseMatrix<T>& mat, Visitor visitor, ThreadPool& pool, int nbChunks=g_nb_chunks )
+{
+	assert( mat.isCompressed() );
+	auto bounds = partitionByNnz( mat.outerIndexPtr(), mat.outerSize(), nbChunks );
+	pool.run( nbChunks, [&]( int chunk )
+	{
+		for( int k=bounds[chunk]; k<bounds[chunk+1]; ++k )
+			for( typename Eigen::SparseMatrix<T>::InnerIterator it(mat,k); it; ++it )
+				visitor( it.row(), it.col(), it.value() );
+	} );
+}
+
+/// Deterministic parallel reduction: returns combine(...combine(combine(init,p_0),p_1)...,p_n) where p_i is the reduction of chunk i
+/**
+- \c map(row,col,value) returns a value of type \c R
+- \c combine(R,R) returns a \c R
+*/
+template<typename T, typename R, typename Map, typename Combine>
+R
+reduceNonZero( const Eigen::SparseMatrix<T>& mat, R init, Map map, Combine combine, ThreadPool& pool, int nbChunks=g_nb_chunks )
+{
+	assert( mat.isCompressed() );
+	auto bounds = partitionByNnz( mat.outerIndexPtr(), mat.outerSize(), nbChunks );
+	std::vector<R> partial( nbChunks, R() );
+	std::vector<char> empty( nbChunks, 1 );
+	pool.run( nbChunks, [&]( int chunk )
+	{
+		R acc = R();
+		bool first = true;
+		for( int k=bounds[chunk]; k<bounds[chunk+1]; ++k )
+			for( typename Eigen::SparseMatrix<T>::InnerIterator it(mat,k); it; ++it )
+			{
+				acc = first ? map( it.row(), it.col(), it.value() ) : combine( acc, map( it.row(), it.col(), it.value() ) );
+				first = false;
+			}
+		partial[chunk] = acc;
+		empty[chunk] = first;
+	} );
+	R res = init;
+	for( int i=0; i<nbChunks; i++ )
+		if( !empty[i] )
+			res = combine( res, partial[i] );
+	return res;
+}
+
+#endif // PARALLEL_TRAVERSAL_HPP
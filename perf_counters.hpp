@@ -0,0 +1,199 @@
+/**
+\file perf_counters.hpp
+\brief Hardware performance counters (Linux \c perf_event_open), to be used alongside \c Timing
+
+Each event is opened on its own, so if one is not supported by the CPU (or by the VM)
+the others are still counted. If \c perf_event_open is not available at all (non-Linux, or
+\c /proc/sys/kernel/perf_event_paranoid too high), all the values are reported as "n/a".
+
+Define \c NO_PERF_COUNTERS to build without it.
+*/
+
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__) && !defined(NO_PERF_COUNTERS)
+	#define HAS_PERF_COUNTERS
+	#include <linux/perf_event.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+/// The events that are recorded
+enum PerfEvent
+{
+	PE_CYCLES,
+	PE_INSTRUCTIONS,
+	PE_L1D_MISSES,
+	PE_LLC_MISSES,
+	PE_DTLB_MISSES,
+	PE_BRANCH_MISSES,
+	PE_NB_EVENTS
+};
+
+/// Short names of events, used for printing
+inline const char* getPerfEventName( int ev )
+{
+	static const char* names[PE_NB_EVENTS] = {
+		"cycles", "instr", "L1d_miss", "LLC_miss", "dTLB_miss", "br_miss"
+	};
+	return names[ev];
+}
+
+/// Counts hardware events for the current process (user space only) between \c start() and \c stop()
+struct PerfCounters
+{
+	int      _fd[PE_NB_EVENTS];
+	uint64_t _values[PE_NB_EVENTS];
+	bool     _valid[PE_NB_EVENTS];
+
+	PerfCounters()
+	{
+		for( int i=0; i<PE_NB_EVENTS; i++ )
+		{
+			_fd[i] = -1;
+			_values[i] = 0;
+			_valid[i] = false;
+		}
+#ifdef HAS_PERF_COUNTERS
+		openEvent( PE_CYCLES,        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES );
+		openEvent( PE_INSTRUCTIONS,  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS );
+		openEvent( PE_L1D_MISSES,    PERF_TYPE_HW_CACHE, cacheConfig( PERF_COUNT_HW_CACHE_L1D ) );
+		openEvent( PE_LLC_MISSES,    PERF_TYPE_HW_CACHE, cacheConfig( PERF_COUNT_HW_CACHE_LL ) );
+		openEvent( PE_DTLB_MISSES,   PERF_TYPE_HW_CACHE, cacheConfig( PERF_COUNT_HW_CACHE_DTLB ) );
+		openEvent( PE_BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES );
+#endif
+		start();
+	}
+	~PerfCounters()
+	{
+#ifdef HAS_PERF_COUNTERS
+		for( int i=0; i<PE_NB_EVENTS; i++ )
+			if( _fd[i] != -1 )
+				close( _fd[i] );
+#endif
+	}
+	PerfCounters( const PerfCounters& ) = delete;
+	PerfCounters& operator = ( const PerfCounters& ) = delete;
+
+/// Returns true if at least one counter could be opened
+	bool isAvailable() const
+	{
+		for( int i=0; i<PE_NB_EVENTS; i++ )
+			if( _fd[i] != -1 )
+				return true;
+		return false;
+	}
+
+/// Reset and enable all the counters
+	void start()
+	{
+#ifdef HAS_PERF_COUNTERS
+		for( int i=0; i<PE_NB_EVENTS; i++ )
+			if( _fd[i] != -1 )
+			{
+				ioctl( _fd[i], PERF_EVENT_IOC_RESET, 0 );
+				ioctl( _fd[i], PERF_EVENT_IOC_ENABLE, 0 );
+			}
+#endif
+	}
+
+/// Disable the counters and read their values, scaled if the kernel had to multiplex them
+	void stop()
+	{
+#ifdef HAS_PERF_COUNTERS
+		for( int i=0; i<PE_NB_EVENTS; i++ )
+		{
+			_valid[i] = false;
+			if( _fd[i] == -1 )
+				continue;
+			ioctl( _fd[i], PERF_EVENT_IOC_DISABLE, 0 );
+			uint64_t buf[3]; // value, time enabled, time running
+			if( read( _fd[i], buf, sizeof(buf) ) != sizeof(buf) || buf[2] == 0 )
+				continue;
+			_values[i] = buf[1] == buf[2] ? buf[0] : static_cast<uint64_t>( 1.0 * buf[0] * buf[1] / buf[2] );
+			_valid[i] = true;
+		}
+#endif
+	}
+
+/// Value of event \c ev at the last call to \c stop()
+	uint64_t get( PerfEvent ev ) const
+	{
+		return _values[ev];
+	}
+	bool isValid( PerfEvent ev ) const
+	{
+		return _valid[ev];
+	}
+
+/// Stops, prints the counters on one line, and restarts (same behavior as \c Timing::PrintDuration())
+	void PrintCounters()
+	{
+		stop();
+		std::cout << "Counters:";
+		for( int i=0; i<PE_NB_EVENTS; i++ )
+		{
+			std::cout << ' ' << getPerfEventName(i) << '=';
+			if( _valid[i] )
+				std::cout << _values[i];
+			else
+				std::cout << "n/a";
+		}
+		if( _valid[PE_CYCLES] && _valid[PE_INSTRUCTIONS] && _values[PE_CYCLES] )
+			std::cout << " IPC=" << 1.0 * _values[PE_INSTRUCTIONS] / _values[PE_CYCLES];
+		std::cout << '\n';
+		start();
+	}
+
+/// Prints the column names, to be used in a data file header
+	static void PrintHeader( std::ostream& f, char sep, const char* prefix="" )
+	{
+		for( int i=0; i<PE_NB_EVENTS; i++ )
+			f << sep << prefix << getPerfEventName(i);
+	}
+
+/// Prints the last values read as extra columns ("NaN" if not available, so gnuplot skips it)
+	void PrintValues( std::ostream& f, char sep ) const
+	{
+		for( int i=0; i<PE_NB_EVENTS; i++ )
+		{
+			f << sep;
+			if( _valid[i] )
+				f << _values[i];
+			else
+				f << "NaN";
+		}
+	}
+
+private:
+#ifdef HAS_PERF_COUNTERS
+	static uint64_t cacheConfig( uint64_t cache )
+	{
+		return cache
+			| ( PERF_COUNT_HW_CACHE_OP_READ << 8 )
+			| ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+	}
+	void openEvent( PerfEvent ev, uint32_t type, uint64_t config )
+	{
+		struct perf_event_attr attr;
+		std::memset( &attr, 0, sizeof(attr) );
+		attr.size           = sizeof(attr);
+		attr.type           = type;
+		attr.config         = config;
+		attr.disabled       = 1;
+		attr.inherit        = 1; // so that threads created afterwards are counted too
+		attr.exclude_kernel = 1;
+		attr.exclude_hv     = 1;
+		attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		_fd[ev] = static_cast<int>( syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 ) );
+	}
+#endif
+};
+
+#endif // PERF_COUNTERS_HPP
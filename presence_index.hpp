@@ -0,0 +1,326 @@
+/**
+\file presence_index.hpp
+\brief Presence indexes (is there a value at \c row, \c col ?) for an Eigen sparse matrix, and an adaptive one
+
+Three representations:
+- a dense bitmap of \c rows x \c cols bits: one memory access per probe, but memory grows as matDim^2
+- a hash set of linearized positions: memory grows with the nb of values
+- the CSC arrays of the Eigen matrix itself (binary search in the column): no extra memory
+
+\c AdaptivePresence picks one of these from \c rows, \c cols and \c nnz, using a cost model
+(\c PresenceCostModel) that can be calibrated by measurement (see eigen_test_5.cpp).
+*/
+
+#ifndef PRESENCE_INDEX_HPP
+#define PRESENCE_INDEX_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cmath>
+#include <cassert>
+#include <unistd.h>
+
+/// Linearized position of an element (64 bits, as \c rows * \c cols can exceed 2^31)
+typedef int64_t PresenceKey;
+
+/// Return true if element at \c row, \c col is empty, using a binary search in the column
+/**
+Same as \c isNull() in the test programs, but does not scan the whole column.
+Requires the matrix to be in compressed mode (which is the case after \c setFromTriplets() )
+*/
+template<typename T>
+bool isNullCsc( const Eigen::SparseMatrix<T>& mat, int row, int col )
+{
+	assert( mat.isCompressed() );
+	const auto* inner = mat.innerIndexPtr();
+	const auto* first = inner + mat.outerIndexPtr()[col];
+	const auto* last  = inner + mat.outerIndexPtr()[col+1];
+	const auto* it = std::lower_bound( first, last, row );
+	return it == last || *it != row;
+}
+
+/// Returns the position of element at \c row, \c col in the value array, or -1 if empty (binary search in the column)
+template<typename T>
+std::ptrdiff_t findCsc( const Eigen::SparseMatrix<T>& mat, int row, int col )
+{
+	assert( mat.isCompressed() );
+	const auto* inner = mat.innerIndexPtr();
+	const auto* first = inner + mat.outerIndexPtr()[col];
+	const auto* last  = inner + mat.outerIndexPtr()[col+1];
+	const auto* it = std::lower_bound( first, last, row );
+	if( it == last || *it != row )
+		return -1;
+	return it - inner;
+}
+
+/// Returns true if bit \c pos is set in \c dead (tombstones of the values, see tombstone_matrix.hpp)
+inline bool isTombstone( const std::vector<uint64_t>* dead, std::ptrdiff_t pos )
+{
+	return dead && ( ( (*dead)[pos>>6] >> (pos&63) ) & 1 );
+}
+
+//-----------------------------------------------------------------------------------
+/// Dense bitmap, one bit per element of the matrix
+struct PresenceBitmap
+{
+	std::vector<uint64_t> _bits;
+	size_t                _cols = 0;
+
+	void init( size_t rows, size_t cols )
+	{
+		_cols = cols;
+		_bits.assign( ( rows * cols + 63 ) / 64, 0 );
+	}
+	void insert( int r, int c )
+	{
+		PresenceKey k = static_cast<PresenceKey>(r) * _cols + c;
+		_bits[k>>6] |= uint64_t(1) << (k&63);
+	}
+	void erase( int r, int c )
+	{
+		PresenceKey k = static_cast<PresenceKey>(r) * _cols + c;
+		_bits[k>>6] &= ~( uint64_t(1) << (k&63) );
+	}
+	bool isNull( int r, int c ) const
+	{
+		PresenceKey k = static_cast<PresenceKey>(r) * _cols + c;
+		return !( ( _bits[k>>6] >> (k&63) ) & 1 );
+	}
+	size_t memoryBytes() const
+	{
+		return _bits.capacity() * sizeof(uint64_t);
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// Hash set of linearized positions
+struct PresenceHash
+{
+	std::unordered_set<PresenceKey> _idx_set;
+	size_t                          _cols = 0;
+
+	void init( size_t /*rows*/, size_t cols, size_t nnz=0 )
+	{
+		_cols = cols;
+		_idx_set.clear();
+		_idx_set.reserve( nnz );
+	}
+	void insert( int r, int c )
+	{
+		_idx_set.insert( static_cast<PresenceKey>(r) * _cols + c );
+	}
+	void erase( int r, int c )
+	{
+		_idx_set.erase( static_cast<PresenceKey>(r) * _cols + c );
+	}
+	bool isNull( int r, int c ) const
+	{
+		return _idx_set.find( static_cast<PresenceKey>(r) * _cols + c ) == _idx_set.cend();
+	}
+/// Estimation: one node per element (key + next pointer + malloc overhead), plus the bucket array
+	size_t memoryBytes() const
+	{
+		return _idx_set.size() * ( sizeof(PresenceKey) + 2*sizeof(void*) ) + _idx_set.bucket_count() * sizeof(void*);
+	}
+};
+
+//-----------------------------------------------------------------------------------
+enum PresenceKind
+{
+	PK_BITMAP,
+	PK_HASH,
+	PK_CSC,
+	PK_NB_KINDS
+};
+
+inline const char* getPresenceKindName( PresenceKind k )
+{
+	static const char* names[PK_NB_KINDS] = { "bitmap", "hash", "csc" };
+	return names[k];
+}
+
+/// Size of last level cache, with a guess if not available
+inline size_t getLLCSize()
+{
+	long s = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+	s = sysconf( _SC_LEVEL3_CACHE_SIZE );
+#endif
+	return s > 0 ? static_cast<size_t>( s ) : size_t(8) << 20;
+}
+
+/// Cost model, gives an estimated duration of a probe (in ns) for each representation
+/**
+Default values are rough figures for a recent x86 machine, use eigen_test_5.cpp to calibrate them.
+
+Each structure has a base cost when it fits in the last level cache, and pays \c missNs
+(a DRAM access) with a probability that grows as it gets bigger than the cache.
+*/
+struct PresenceCostModel
+{
+	double bitmapNs     = 2.;   ///< probe of an in-cache bitmap
+	double hashNs       = 20.;  ///< probe of an in-cache hash set
+	double cscBaseNs    = 10.;  ///< access to the column bounds in CSC
+	double cscStepNs    = 4.;   ///< one step of the binary search in the column
+	double missNs       = 80.;  ///< penalty of a DRAM access
+	double hashBytesPerElem = 40.;
+	size_t llcBytes     = getLLCSize();
+	size_t memBudget    = size_t(1) << 30; ///< max memory used by an auxiliary index (bitmap or hash)
+
+/// Probability that an access to a structure of \c bytes goes to DRAM
+	double missRatio( double bytes ) const
+	{
+		return bytes > llcBytes ? 1. - llcBytes / bytes : 0.;
+	}
+/// Memory needed by representation \c k (0 for CSC, as it uses the matrix arrays)
+	double memoryBytes( PresenceKind k, size_t rows, size_t cols, size_t nnz ) const
+	{
+		switch( k )
+		{
+			case PK_BITMAP: return 1. * rows * cols / 8;
+			case PK_HASH:   return 1. * nnz * hashBytesPerElem;
+			default:        return 0.;
+		}
+	}
+/// Estimated cost of one probe, in ns (infinity if the structure does not fit in \c memBudget)
+	double estimate( PresenceKind k, size_t rows, size_t cols, size_t nnz ) const
+	{
+		double mem = memoryBytes( k, rows, cols, nnz );
+		if( mem > memBudget )
+			return std::numeric_limits<double>::infinity();
+		switch( k )
+		{
+			case PK_BITMAP:
+				return bitmapNs + missNs * missRatio( mem );
+			case PK_HASH:
+				return hashNs + missNs * missRatio( mem );
+			default:
+			{
+				double perCol = cols ? 1. * nnz / cols : 0.;
+				double matBytes = ( cols + 1. + nnz ) * sizeof(int);
+				double steps = std::log2( 1. + perCol );
+				return cscBaseNs + cscStepNs * steps + missNs * missRatio( matBytes ) * ( 1. + steps );
+			}
+		}
+	}
+/// Returns the representation with the lowest estimated cost, and stores that cost in \c cost
+	PresenceKind choose( size_t rows, size_t cols, size_t nnz, double* cost=nullptr ) const
+	{
+		PresenceKind best = PK_CSC;
+		double bestCost = estimate( PK_CSC, rows, cols, nnz );
+		for( int k=0; k<PK_CSC; k++ )
+		{
+			double c = estimate( static_cast<PresenceKind>(k), rows, cols, nnz );
+			if( c < bestCost )
+			{
+				bestCost = c;
+				best = static_cast<PresenceKind>(k);
+			}
+		}
+		if( cost )
+			*cost = bestCost;
+		return best;
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// Presence index that selects its representation when built from a matrix
+/**
+The choice is done again at each call to \c build(), so it follows the changes of density
+between two rebuilds.
+*/
+template<typename T>
+struct AdaptivePresence
+{
+	PresenceCostModel             _model;
+	PresenceKind                  _kind = PK_CSC;
+	double                        _estimatedCost = 0.;
+	PresenceBitmap                _bitmap;
+	PresenceHash                  _hash;
+	const Eigen::SparseMatrix<T>* _mat = nullptr;
+	const std::vector<uint64_t>*  _dead = nullptr;  ///< tombstones of the values of \c _mat, if any
+
+/// Build the index from the (compressed) matrix \c mat, that must outlive this object
+/**
+If the matrix has erased values that are not yet removed (see tombstone_matrix.hpp), \c dead holds their tombstones,
+and must also outlive this object
+*/
+	void build( const Eigen::SparseMatrix<T>& mat, const std::vector<uint64_t>* dead=nullptr )
+	{
+		double cost;
+		PresenceKind k = _model.choose( mat.rows(), mat.cols(), mat.nonZeros(), &cost );
+		build( mat, k, dead );
+		_estimatedCost = cost;
+	}
+/// Build the index using representation \c kind
+	void build( const Eigen::SparseMatrix<T>& mat, PresenceKind kind, const std::vector<uint64_t>* dead=nullptr )
+	{
+		_mat  = &mat;
+		_dead = dead;
+		_kind = kind;
+		_estimatedCost = _model.estimate( kind, mat.rows(), mat.cols(), mat.nonZeros() );
+
+		_bitmap = PresenceBitmap();
+		_hash   = PresenceHash();
+		if( kind == PK_CSC )
+			return;
+		if( kind == PK_BITMAP )
+			_bitmap.init( mat.rows(), mat.cols() );
+		else
+			_hash.init( mat.rows(), mat.cols(), mat.nonZeros() );
+
+		for( int k=0; k<mat.outerSize(); ++k )
+			for( typename Eigen::SparseMatrix<T>::InnerIterator it(mat,k); it; ++it )
+			{
+				if( isTombstone( dead, &it.value() - mat.valuePtr() ) )
+					continue;
+				if( kind == PK_BITMAP )
+					_bitmap.insert( it.row(), it.col() );
+				else
+					_hash.insert( it.row(), it.col() );
+			}
+	}
+
+	bool isNull( int r, int c ) const
+	{
+		switch( _kind )
+		{
+			case PK_BITMAP: return _bitmap.isNull( r, c );
+			case PK_HASH:   return _hash.isNull( r, c );
+			default:
+			{
+				std::ptrdiff_t pos = findCsc( *_mat, r, c );
+				return pos < 0 || isTombstone( _dead, pos );
+			}
+		}
+	}
+/// Removes element \c r, \c c from the index, once it has been erased in the matrix.
+/// Nothing to do with \c PK_CSC, as the tombstones of the matrix are checked
+	void erase( int r, int c )
+	{
+		if( _kind == PK_BITMAP )
+			_bitmap.erase( r, c );
+		else if( _kind == PK_HASH )
+			_hash.erase( r, c );
+	}
+
+	PresenceKind getKind() const
+	{
+		return _kind;
+	}
+	double getEstimatedCost() const
+	{
+		return _estimatedCost;
+	}
+/// Extra memory used, on top of the matrix
+	size_t memoryBytes() const
+	{
+		return _bitmap.memoryBytes() + _hash.memoryBytes();
+	}
+};
+
+#endif // PRESENCE_INDEX_HPP
@@ -0,0 +1,256 @@
+/**
+\file rank_select.hpp
+\brief Succinct presence index: bitvector with rank / select, giving the position of the value in a dense payload array
+
+One bit per element of the matrix, in column-major order (bit c * rows + r), so that the values, in the order of
+the bits, are exactly the value array of the Eigen (column-major) matrix.
+- presence: one bit read
+- \c rank1(i) (nb of bits set before bit i) is the position of the value in the payload array, so there is no need
+for the inner index, nor for a binary search
+- \c select1(k) (position of the k-th bit set) gives back the row and column of the k-th value
+
+Rank directory (same layout as "rank9"-like structures, ~4.7% overhead):
+- every 4096 bits (superblock): 64 bits, nb of bits set before the superblock
+- every 512 bits (block): 16 bits, nb of bits set between the start of the superblock and the block
+- then popcount of at most 8 words
+
+\c RankSelectMatrix uses rows * cols bits, so it is for matrices that are not too large.
+\c TwoLevelRankSelectMatrix first has one bit per column (non-empty or not), then a bitmap of \c rows bits for each
+non-empty column only, so it is smaller when many columns are empty (hypersparse matrices).
+*/
+
+#ifndef RANK_SELECT_HPP
+#define RANK_SELECT_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+#include "batch_lookup.hpp"
+
+/// Bitvector with rank and select support
+struct RankBitvector
+{
+	std::vector<uint64_t> _bits;
+	std::vector<uint64_t> _superRank;  ///< one per 4096 bits (64 words)
+	std::vector<uint16_t> _blockRank;  ///< one per 512 bits (8 words), relative to the superblock
+	size_t                _size = 0;
+	size_t                _nbOnes = 0;
+
+/// \c n bits, all cleared
+	void init( size_t n )
+	{
+		_size = n;
+		size_t nbWords = ( n + 63 ) / 64 + 1; // one more word, so that rank1(_size) can read it
+		_bits.assign( ( nbWords + 7 ) / 8 * 8, 0 ); // whole blocks, read by rank1()
+		_superRank.clear();
+		_blockRank.clear();
+		_nbOnes = 0;
+	}
+	void set( size_t i )
+	{
+		assert( i < _size );
+		_bits[i>>6] |= uint64_t(1) << (i&63);
+	}
+/// Builds the rank directory, to be called after all the \c set()
+	void buildRank()
+	{
+		size_t nbWords = _bits.size();
+		_superRank.assign( ( nbWords + 63 ) / 64, 0 );
+		_blockRank.assign( ( nbWords + 7 ) / 8, 0 );
+		uint64_t total = 0;
+		uint64_t inSuper = 0;
+		for( size_t w=0; w<nbWords; w++ )
+		{
+			if( w % 64 == 0 )
+			{
+				_superRank[w/64] = total;
+				inSuper = 0;
+			}
+			if( w % 8 == 0 )
+				_blockRank[w/8] = static_cast<uint16_t>( inSuper );
+			int n = popcount64( _bits[w] );
+			total   += n;
+			inSuper += n;
+		}
+		_nbOnes = total;
+	}
+
+	size_t size() const { return _size; }
+	size_t nbOnes() const { return _nbOnes; }
+
+	bool get( size_t i ) const
+	{
+		return ( _bits[i>>6] >> (i&63) ) & 1;
+	}
+/// Nb of bits set in [0,i)
+	size_t rank1( size_t i ) const
+	{
+		size_t w = i >> 6;
+		size_t r = _superRank[w/64] + _blockRank[w/8];
+		const uint64_t* block = _bits.data() + ( w & ~size_t(7) );
+		size_t nbFull = w & 7;
+		for( size_t k=0; k<8; k++ ) // fixed trip count, so that the loop is not mispredicted
+			r += popcount64( block[k] & -static_cast<uint64_t>( k < nbFull ) );
+		return r + popcount64( _bits[w] & ( ( uint64_t(1) << (i&63) ) - 1 ) );
+	}
+/// Position of the bit set number \c k (starting at 0). \c k must be lower than \c nbOnes()
+	size_t select1( size_t k ) const
+	{
+		assert( k < _nbOnes );
+	// last superblock with rank <= k
+		size_t s = std::upper_bound( _superRank.begin(), _superRank.end(), k ) - _superRank.begin() - 1;
+		k -= _superRank[s];
+	// last block of this superblock with rank <= k
+		size_t b = s * 8;
+		size_t bEnd = std::min( b + 8, _blockRank.size() );
+		while( b + 1 < bEnd && _blockRank[b+1] <= k )
+			b++;
+		k -= _blockRank[b];
+	// word, then bit
+		size_t w = b * 8;
+		for( int n = popcount64( _bits[w] ); static_cast<size_t>( n ) <= k; n = popcount64( _bits[++w] ) )
+			k -= n;
+		uint64_t word = _bits[w];
+		for( size_t j=0; j<k; j++ )
+			word &= word - 1;
+		return w * 64 + lowestBit64( word );
+	}
+	size_t memoryBytes() const
+	{
+		return _bits.capacity() * sizeof(uint64_t) + rankBytes();
+	}
+/// Memory of the rank directory only
+	size_t rankBytes() const
+	{
+		return _superRank.capacity() * sizeof(uint64_t) + _blockRank.capacity() * sizeof(uint16_t);
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// Presence and values of a matrix: one bit per element + dense payload array
+template<typename T>
+struct RankSelectMatrix
+{
+	size_t         _rows = 0;
+	size_t         _cols = 0;
+	RankBitvector  _bits;
+	std::vector<T> _values;  ///< in the order of the bits (column-major)
+
+/// Builds from a compressed column-major matrix
+	void build( const Eigen::SparseMatrix<T>& mat )
+	{
+		assert( mat.isCompressed() );
+		_rows = mat.rows();
+		_cols = mat.cols();
+		_bits.init( _rows * _cols );
+		for( int k=0; k<mat.outerSize(); ++k )
+			for( typename Eigen::SparseMatrix<T>::InnerIterator it(mat,k); it; ++it )
+				_bits.set( static_cast<size_t>( it.col() ) * _rows + it.row() );
+		_bits.buildRank();
+		_values.assign( mat.valuePtr(), mat.valuePtr() + mat.nonZeros() );
+	}
+
+	bool isNull( int r, int c ) const
+	{
+		return !_bits.get( static_cast<size_t>(c) * _rows + r );
+	}
+/// Returns the position of the value in \c _values, or -1 if empty
+	std::ptrdiff_t find( int r, int c ) const
+	{
+		size_t i = static_cast<size_t>(c) * _rows + r;
+		if( !_bits.get( i ) )
+			return -1;
+		return _bits.rank1( i );
+	}
+/// Pointer to the value, or null if empty
+	const T* coeffPtr( int r, int c ) const
+	{
+		std::ptrdiff_t pos = find( r, c );
+		return pos < 0 ? nullptr : &_values[pos];
+	}
+/// Row and column of the value number \c k
+	std::pair<int,int> position( size_t k ) const
+	{
+		size_t i = _bits.select1( k );
+		return std::make_pair( static_cast<int>( i % _rows ), static_cast<int>( i / _rows ) );
+	}
+	size_t nonZeros() const { return _values.size(); }
+/// Memory of the index (bits + rank directory), without the values
+	size_t indexBytes() const
+	{
+		return _bits.memoryBytes();
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// Same as \c RankSelectMatrix, with bitmaps only for the non-empty columns
+template<typename T>
+struct TwoLevelRankSelectMatrix
+{
+	size_t         _rows = 0;
+	size_t         _cols = 0;
+	RankBitvector  _nonEmptyCols;  ///< one bit per column
+	RankBitvector  _bits;          ///< \c rows bits for each non-empty column, in column order
+	std::vector<T> _values;
+
+	void build( const Eigen::SparseMatrix<T>& mat )
+	{
+		assert( mat.isCompressed() );
+		_rows = mat.rows();
+		_cols = mat.cols();
+		const auto* outer = mat.outerIndexPtr();
+		_nonEmptyCols.init( _cols );
+		for( size_t c=0; c<_cols; c++ )
+			if( outer[c+1] != outer[c] )
+				_nonEmptyCols.set( c );
+		_nonEmptyCols.buildRank();
+
+		_bits.init( _nonEmptyCols.nbOnes() * _rows );
+		size_t slot = 0;
+		for( int k=0; k<mat.outerSize(); ++k )
+		{
+			if( outer[k+1] == outer[k] )
+				continue;
+			for( typename Eigen::SparseMatrix<T>::InnerIterator it(mat,k); it; ++it )
+				_bits.set( slot * _rows + it.row() );
+			slot++;
+		}
+		_bits.buildRank();
+		_values.assign( mat.valuePtr(), mat.valuePtr() + mat.nonZeros() );
+	}
+
+	bool isNull( int r, int c ) const
+	{
+		if( !_nonEmptyCols.get( c ) )
+			return true;
+		return !_bits.get( _nonEmptyCols.rank1( c ) * _rows + r );
+	}
+	std::ptrdiff_t find( int r, int c ) const
+	{
+		if( !_nonEmptyCols.get( c ) )
+			return -1;
+		size_t i = _nonEmptyCols.rank1( c ) * _rows + r;
+		if( !_bits.get( i ) )
+			return -1;
+		return _bits.rank1( i );
+	}
+	const T* coeffPtr( int r, int c ) const
+	{
+		std::ptrdiff_t pos = find( r, c );
+		return pos < 0 ? nullptr : &_values[pos];
+	}
+	std::pair<int,int> position( size_t k ) const
+	{
+		size_t i = _bits.select1( k );
+		return std::make_pair( static_cast<int>( i % _rows ), static_cast<int>( _nonEmptyCols.select1( i / _rows ) ) );
+	}
+	size_t nonZeros() const { return _values.size(); }
+	size_t indexBytes() const
+	{
+		return _nonEmptyCols.memoryBytes() + _bits.memoryBytes();
+	}
+};
+
+#endif // RANK_SELECT_HPP
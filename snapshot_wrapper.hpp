@@ -0,0 +1,208 @@
+/**
+\file snapshot_wrapper.hpp
+\brief A wrapper over Eigen Sparse Matrix whose readers keep running while the matrix is rebuilt (RCU-style)
+
+The matrix and its presence index (a \c std::set of linearized positions, as in \c EigenSMWrapper) are grouped in an
+immutable \c Snapshot. A rebuild creates a new snapshot on the writer thread, then publishes it with an atomic swap of
+the current pointer: readers never wait, they use either the old or the new version.
+
+The old snapshot is freed when no reader can still use it, using epoch-based reclamation:
+- each reader announces the current global epoch in its own slot when it starts a read, and clears it at the end
+- the writer advances the global epoch after each swap, and frees the snapshots retired at epoch \c e
+when all the announced epochs are greater than \c e
+
+So a read costs one store in a slot that no other thread writes, instead of an atomic increment of a shared reference count.
+*/
+
+#ifndef SNAPSHOT_WRAPPER_HPP
+#define SNAPSHOT_WRAPPER_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+
+/// Max nb of reader threads registered at the same time
+constexpr int g_max_readers = 64;
+
+//-----------------------------------------------------------------------------------
+/// Epoch-based reclamation: tells when no reader can still access an object retired at a given epoch
+struct EpochManager
+{
+/// One per reader, on its own cache line. Epoch 0 means "not reading"
+	struct alignas(64) Slot
+	{
+		std::atomic<uint64_t> epoch;
+		std::atomic<bool>     used;
+	};
+
+	std::atomic<uint64_t> _globalEpoch;
+	Slot                  _slots[g_max_readers];
+
+	EpochManager(): _globalEpoch(1)
+	{
+		for( auto& s: _slots )
+		{
+			s.epoch = 0;
+			s.used = false;
+		}
+	}
+
+/// Returns a free slot, throws if too many readers
+	int registerReader()
+	{
+		for( int i=0; i<g_max_readers; i++ )
+		{
+			bool expected = false;
+			if( _slots[i].used.compare_exchange_strong( expected, true ) )
+				return i;
+		}
+		throw std::runtime_error( "EpochManager: too many readers" );
+	}
+	void unregisterReader( int slot )
+	{
+		_slots[slot].epoch = 0;
+		_slots[slot].used = false;
+	}
+
+/// Called by a reader before accessing shared data (must be seq_cst, so that the writer sees it before swapping)
+	void enter( int slot )
+	{
+		_slots[slot].epoch.store( _globalEpoch.load() );
+	}
+	void exit( int slot )
+	{
+		_slots[slot].epoch.store( 0, std::memory_order_release );
+	}
+
+/// Called by the writer after publishing a new version, returns the epoch at which the old one is retired
+	uint64_t advance()
+	{
+		return _globalEpoch.fetch_add( 1 );
+	}
+
+/// Returns true if objects retired at epoch \c e can be freed
+	bool isSafe( uint64_t e ) const
+	{
+		for( const auto& s: _slots )
+		{
+			uint64_t se = s.epoch.load();
+			if( se != 0 && se <= e )
+				return false;
+		}
+		return true;
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// a wrapper over Eigen Sparse Matrix, adds a std::set of linearized positions, and allows reads during rebuilds
+template<typename T>
+struct SnapshotSMWrapper
+{
+/// An immutable version of the matrix
+	struct Snapshot
+	{
+		Eigen::SparseMatrix<T> _data;
+		std::set<int64_t>      _idx_set;
+		size_t                 _version = 0;
+
+		Snapshot( int r, int c ): _data(r,c)
+		{}
+		bool isNull( int r, int c ) const
+		{
+			int64_t idx = static_cast<int64_t>(r) * _data.cols() + c;
+			return _idx_set.find( idx ) == _idx_set.cend();
+		}
+	};
+
+	std::atomic<Snapshot*>                    _current;
+	EpochManager                              _epochs;
+	std::mutex                                _writerMutex; ///< one rebuild at a time
+	std::vector<std::pair<uint64_t,Snapshot*>> _retired;     ///< snapshots waiting to be freed, with their retire epoch
+
+	SnapshotSMWrapper( int r, int c ): _current( new Snapshot(r,c) )
+	{}
+	~SnapshotSMWrapper()
+	{
+		delete _current.load();
+		for( auto& p: _retired )
+			delete p.second;
+	}
+	SnapshotSMWrapper( const SnapshotSMWrapper& ) = delete;
+	SnapshotSMWrapper& operator = ( const SnapshotSMWrapper& ) = delete;
+
+/// Builds a new version from the triplets and publishes it. Readers are not blocked
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie )
+	{
+		std::lock_guard<std::mutex> lock( _writerMutex );
+		Snapshot* cur = _current.load();
+		Snapshot* snap = new Snapshot( cur->_data.rows(), cur->_data.cols() );
+		snap->_version = cur->_version + 1;
+		snap->_data.setFromTriplets( ib, ie );
+		for( auto it = ib;it != ie; ++it )
+			snap->_idx_set.insert( static_cast<int64_t>( it->row() ) * snap->_data.cols() + it->col() );
+
+		Snapshot* old = _current.exchange( snap );
+		_retired.push_back( std::make_pair( _epochs.advance(), old ) );
+		reclaim();
+	}
+
+/// Frees the retired snapshots that can not be accessed anymore, returns the nb of snapshots still waiting
+	size_t reclaim()
+	{
+		size_t j = 0;
+		for( size_t i=0; i<_retired.size(); i++ )
+			if( _epochs.isSafe( _retired[i].first ) )
+				delete _retired[i].second;
+			else
+				_retired[j++] = _retired[i];
+		_retired.resize( j );
+		return j;
+	}
+
+/// Read access for one thread: create one per reader thread
+	class Reader
+	{
+		SnapshotSMWrapper& _wrapper;
+		int                _slot;
+	public:
+		Reader( SnapshotSMWrapper& w ): _wrapper(w), _slot( w._epochs.registerReader() )
+		{}
+		~Reader()
+		{
+			_wrapper._epochs.unregisterReader( _slot );
+		}
+		Reader( const Reader& ) = delete;
+		Reader& operator = ( const Reader& ) = delete;
+
+/// Calls \c f with the current snapshot, that stays valid until \c f returns (use it to do several queries on the same version)
+		template<typename Func>
+		auto read( Func f ) -> decltype( f( std::declval<const Snapshot&>() ) )
+		{
+			struct Guard
+			{
+				EpochManager& _em;
+				int           _slot;
+				~Guard() { _em.exit( _slot ); }
+			} guard{ _wrapper._epochs, _slot };
+			_wrapper._epochs.enter( _slot );
+			return f( *_wrapper._current.load() );
+		}
+
+		bool isNull( int r, int c )
+		{
+			return read( [r,c]( const Snapshot& s ){ return s.isNull( r, c ); } );
+		}
+		size_t getVersion()
+		{
+			return read( []( const Snapshot& s ){ return s._version; } );
+		}
+	};
+};
+
+#endif // SNAPSHOT_WRAPPER_HPP
@@ -0,0 +1,91 @@
+/**
+\file spmv.hpp
+\brief Multithreaded sparse matrix - vector product y = A.x, for numeric scalars
+
+- row-major: each row is a dot product, so rows are split in chunks of about the same nb of values,
+and each thread writes its own part of \c y
+- column-major: a column adds its values to \c y at random rows, so threads can not share \c y without atomics.
+Instead, columns are split in one block per thread, each thread accumulates in its own copy of \c y,
+and these copies are then summed (in parallel, by row ranges). No atomics, and the result is deterministic.
+*/
+
+#ifndef SPMV_HPP
+#define SPMV_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include "thread_pool.hpp"
+#include "parallel_traversal.hpp"
+
+/// y = A.x, A row-major
+template<typename S>
+void
+spmvRowMajor( const Eigen::SparseMatrix<S,Eigen::RowMajor>& A, const S* x, S* y, ThreadPool& pool, int nbChunks=g_nb_chunks )
+{
+	assert( A.isCompressed() );
+	const auto* outer = A.outerIndexPtr();
+	const auto* inner = A.innerIndexPtr();
+	const S*    val   = A.valuePtr();
+	auto bounds = partitionByNnz( outer, A.outerSize(), nbChunks );
+	pool.run( nbChunks, [&]( int chunk )
+	{
+		for( int r=bounds[chunk]; r<bounds[chunk+1]; r++ )
+		{
+			S sum = 0;
+			for( auto i=outer[r]; i<outer[r+1]; i++ )
+				sum += val[i] * x[inner[i]];
+			y[r] = sum;
+		}
+	} );
+}
+
+/// y = A.x, A column-major. \c work is resized to hold one copy of \c y per thread
+template<typename S>
+void
+spmvColMajor( const Eigen::SparseMatrix<S>& A, const S* x, S* y, ThreadPool& pool, std::vector<S>& work )
+{
+	assert( A.isCompressed() );
+	const auto* outer = A.outerIndexPtr();
+	const auto* inner = A.innerIndexPtr();
+	const S*    val   = A.valuePtr();
+	const int   nbBlocks = pool.size();
+	const size_t rows = A.rows();
+
+	if( nbBlocks == 1 ) // no need for a copy
+	{
+		std::fill( y, y + rows, S(0) );
+		for( int c=0; c<A.outerSize(); c++ )
+			for( auto i=outer[c]; i<outer[c+1]; i++ )
+				y[inner[i]] += val[i] * x[c];
+		return;
+	}
+
+	work.resize( nbBlocks * rows );
+	auto bounds = partitionByNnz( outer, A.outerSize(), nbBlocks );
+	pool.run( nbBlocks, [&]( int b )
+	{
+		S* yb = work.data() + b * rows;
+		std::fill( yb, yb + rows, S(0) );
+		for( int c=bounds[b]; c<bounds[b+1]; c++ )
+			for( auto i=outer[c]; i<outer[c+1]; i++ )
+				yb[inner[i]] += val[i] * x[c];
+	} );
+
+	const int nbChunks = std::min<size_t>( g_nb_chunks, rows );
+	pool.run( nbChunks, [&]( int chunk )
+	{
+		size_t r0 = rows * chunk / nbChunks;
+		size_t r1 = rows * (chunk+1) / nbChunks;
+		for( size_t r=r0; r<r1; r++ )
+		{
+			S sum = 0;
+			for( int b=0; b<nbBlocks; b++ )
+				sum += work[b*rows + r];
+			y[r] = sum;
+		}
+	} );
+}
+
+#endif // SPMV_HPP
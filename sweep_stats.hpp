@@ -0,0 +1,124 @@
+/**
+\file sweep_stats.hpp
+\brief Small statistics helpers for the benchmark sweeps: mean / standard deviation of samples, and Welch's t-test
+
+Welch's t-test compares the means of two sets of samples that may have different variances and sizes,
+which is the case when comparing a run with a baseline measured on another day.
+The p-value uses the Student t distribution, computed with the regularized incomplete beta function
+(continued fraction, as in "Numerical Recipes"), so there is no dependency.
+*/
+
+#ifndef SWEEP_STATS_HPP
+#define SWEEP_STATS_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/// Summary of a set of samples
+struct SampleStats
+{
+	size_t n      = 0;
+	double mean   = 0.;
+	double stddev = 0.;  ///< sample standard deviation (n-1)
+
+	SampleStats() {}
+	SampleStats( size_t nn, double m, double s ): n(nn), mean(m), stddev(s) {}
+	explicit SampleStats( const std::vector<double>& samples )
+	{
+		n = samples.size();
+		for( auto v: samples )
+			mean += v;
+		mean /= std::max( n, size_t(1) );
+		double sq = 0.;
+		for( auto v: samples )
+			sq += ( v - mean ) * ( v - mean );
+		stddev = n > 1 ? std::sqrt( sq / ( n - 1 ) ) : 0.;
+	}
+};
+
+namespace priv {
+
+/// Continued fraction for the incomplete beta function (modified Lentz method)
+inline double
+betaContFrac( double a, double b, double x )
+{
+	const double tiny = 1e-300;
+	double c = 1.;
+	double d = 1. - ( a + b ) * x / ( a + 1. );
+	d = 1. / ( std::fabs(d) < tiny ? tiny : d );
+	double h = d;
+	for( int m=1; m<300; m++ )
+	{
+		for( int k=0; k<2; k++ )
+		{
+			double num = k == 0
+				? m * ( b - m ) * x / ( ( a + 2*m - 1 ) * ( a + 2*m ) )
+				: -( a + m ) * ( a + b + m ) * x / ( ( a + 2*m ) * ( a + 2*m + 1 ) );
+			d = 1. + num * d;
+			d = 1. / ( std::fabs(d) < tiny ? tiny : d );
+			c = 1. + num / c;
+			c = std::fabs(c) < tiny ? tiny : c;
+			h *= d * c;
+			if( k == 1 && std::fabs( d * c - 1. ) < 1e-12 )
+				return h;
+		}
+	}
+	return h;
+}
+
+} // namespace priv
+
+/// Regularized incomplete beta function I_x(a,b)
+inline double
+incompleteBeta( double a, double b, double x )
+{
+	if( x <= 0. )
+		return 0.;
+	if( x >= 1. )
+		return 1.;
+	double lbeta = std::lgamma( a + b ) - std::lgamma( a ) - std::lgamma( b ) + a * std::log( x ) + b * std::log( 1. - x );
+	if( x < ( a + 1. ) / ( a + b + 2. ) )
+		return std::exp( lbeta ) * priv::betaContFrac( a, b, x ) / a;
+	return 1. - std::exp( lbeta ) * priv::betaContFrac( b, a, 1. - x ) / b;
+}
+
+/// P(T > t) for a Student t distribution with \c df degrees of freedom
+inline double
+studentUpperTail( double t, double df )
+{
+	double p = 0.5 * incompleteBeta( 0.5 * df, 0.5, df / ( df + t * t ) );
+	return t > 0. ? p : 1. - p;
+}
+
+/// Result of Welch's t-test
+struct WelchResult
+{
+	double t  = 0.;
+	double df = 0.;
+	double p  = 1.;  ///< one-sided p-value of "mean of \c a is greater than mean of \c b"
+};
+
+/// Welch's t-test: is the mean of \c a greater than the mean of \c b ?
+inline WelchResult
+welchTest( const SampleStats& a, const SampleStats& b )
+{
+	WelchResult res;
+	if( a.n < 2 || b.n < 2 )
+		return res;
+	double va = a.stddev * a.stddev / a.n;
+	double vb = b.stddev * b.stddev / b.n;
+	if( va + vb == 0. )
+	{
+		res.t = a.mean > b.mean ? std::numeric_limits<double>::infinity() : 0.;
+		res.p = a.mean > b.mean ? 0. : 1.;
+		return res;
+	}
+	res.t  = ( a.mean - b.mean ) / std::sqrt( va + vb );
+	res.df = ( va + vb ) * ( va + vb ) / ( va * va / ( a.n - 1 ) + vb * vb / ( b.n - 1 ) );
+	res.p  = studentUpperTail( res.t, res.df );
+	return res;
+}
+
+#endif // SWEEP_STATS_HPP
@@ -0,0 +1,104 @@
+/**
+\file thread_pool.hpp
+\brief Minimal fork-join thread pool: \c run(nbTasks,f) calls \c f(i) for all i in [0,nbTasks) on the pool threads and waits
+
+The calling thread also takes tasks, so a pool of size 1 has no extra thread.
+Tasks are distributed dynamically (atomic counter), so they can have different costs.
+*/
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <vector>
+
+struct ThreadPool
+{
+	std::vector<std::thread>  _threads;
+	std::mutex                _mutex;
+	std::condition_variable   _cvStart;
+	std::condition_variable   _cvDone;
+	std::function<void(int)>  _task;
+	int                       _nbTasks = 0;
+	std::atomic<int>          _nextTask;
+	int                       _nbBusy = 0;       ///< nb of pool threads still working on the current run
+	size_t                    _generation = 0;   ///< incremented at each run
+	bool                      _stop = false;
+
+/// \c nbThreads includes the calling thread (0: nb of hardware threads)
+	explicit ThreadPool( int nbThreads=0 ): _nextTask(0)
+	{
+		if( nbThreads <= 0 )
+			nbThreads = std::max( 1u, std::thread::hardware_concurrency() );
+		for( int i=1; i<nbThreads; i++ )
+			_threads.push_back( std::thread( [this](){ workerLoop(); } ) );
+	}
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock( _mutex );
+			_stop = true;
+		}
+		_cvStart.notify_all();
+		for( auto& th: _threads )
+			th.join();
+	}
+	ThreadPool( const ThreadPool& ) = delete;
+	ThreadPool& operator = ( const ThreadPool& ) = delete;
+
+	int size() const
+	{
+		return _threads.size() + 1;
+	}
+
+/// Calls \c f(i) for i in [0,nbTasks), returns when all are done
+	void run( int nbTasks, std::function<void(int)> f )
+	{
+		{
+			std::lock_guard<std::mutex> lock( _mutex );
+			_task = std::move( f );
+			_nbTasks = nbTasks;
+			_nextTask = 0;
+			_nbBusy = _threads.size();
+			_generation++;
+		}
+		_cvStart.notify_all();
+		doTasks();
+		std::unique_lock<std::mutex> lock( _mutex );
+		_cvDone.wait( lock, [this](){ return _nbBusy == 0; } );
+	}
+
+private:
+	void doTasks()
+	{
+		for( int i = _nextTask++; i < _nbTasks; i = _nextTask++ )
+			_task( i );
+	}
+	void workerLoop()
+	{
+		size_t generation = 0;
+		while( true )
+		{
+			{
+				std::unique_lock<std::mutex> lock( _mutex );
+				_cvStart.wait( lock, [&](){ return _stop || _generation != generation; } );
+				if( _stop )
+					return;
+				generation = _generation;
+			}
+			doTasks();
+			{
+				std::lock_guard<std::mutex> lock( _mutex );
+				_nbBusy--;
+			}
+			_cvDone.notify_one();
+		}
+	}
+};
+
+#endif // THREAD_POOL_HPP
@@ -1,4 +1,5 @@
-
+#ifndef TIMING_HPP
+#define TIMING_HPP
 
 #include <chrono>
 #include <iostream>
@@ -38,4 +39,13 @@ struct Timing
 		initTimer();
 		return a; //std::chrono::duration_cast<std::chrono::milliseconds>(MyClock::now() - _startTime).count;
 	}
+/// Same as getDuration(), but in nanoseconds (for measures of a few ms)
+	MyTimePoint::rep getDurationNs()
+	{
+		auto a = std::chrono::duration_cast<std::chrono::nanoseconds>(MyClock::now() - _startTime).count();
+		initTimer();
+		return a;
+	}
 };
+
+#endif // TIMING_HPP
@@ -0,0 +1,165 @@
+/**
+\file tombstone_matrix.hpp
+\brief Eigen sparse matrix with removal of values: tombstones, and deferred compaction
+
+Removing a value from a compressed matrix shifts all the values after it, so erasing values one by one
+costs O(nnz) each. Instead, an erased value is only marked as dead in a bit vector (one bit per stored value),
+and the arrays are compacted (dead values removed, in a single pass) once the ratio of dead values exceeds
+\c _maxDeadRatio, or when \c compact() is called.
+
+Lookups (\c isNull()) check the tombstones, so erased values are seen as empty immediately.
+A presence index (see \c AdaptivePresence in presence_index.hpp) must be updated by the caller
+on each erased value (see \c eraseIf() ); a \c PK_CSC one is given the tombstones, so it sees them too.
+Compaction changes the position of the values, not the positions in the matrix, so the indexes stay valid.
+*/
+
+#ifndef TOMBSTONE_MATRIX_HPP
+#define TOMBSTONE_MATRIX_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cassert>
+#include "presence_index.hpp"
+
+template<typename T>
+struct TombstoneMatrix
+{
+	typedef typename Eigen::SparseMatrix<T>::StorageIndex StorageIndex;
+
+	Eigen::SparseMatrix<T> _data;
+	std::vector<uint64_t>  _dead;              ///< one bit per stored value
+	size_t                 _nbDead = 0;
+	double                 _maxDeadRatio = 0.25;  ///< compaction is done when this ratio of values is dead
+	size_t                 _nbCompactions = 0;
+
+	TombstoneMatrix( int r, int c ): _data(r,c)
+	{}
+
+	template<typename InputIterators>
+	void setFromTriplets( const InputIterators& ib, const InputIterators& ie )
+	{
+		_data.setFromTriplets( ib, ie );
+		_dead.assign( ( _data.nonZeros() + 63 ) / 64, 0 );
+		_nbDead = 0;
+	}
+
+	size_t rows() const { return _data.rows(); }
+	size_t cols() const { return _data.cols(); }
+/// Nb of values not erased
+	size_t nonZeros() const { return _data.nonZeros() - _nbDead; }
+	size_t nbDead() const { return _nbDead; }
+
+	bool isDead( std::ptrdiff_t pos ) const
+	{
+		return ( _dead[pos>>6] >> (pos&63) ) & 1;
+	}
+	bool isNull( int r, int c ) const
+	{
+		std::ptrdiff_t pos = findCsc( _data, r, c );
+		return pos < 0 || isDead( pos );
+	}
+/// Removes element \c r, \c c. Returns false if it was already empty
+	bool erase( int r, int c )
+	{
+		std::ptrdiff_t pos = findCsc( _data, r, c );
+		if( pos < 0 || isDead( pos ) )
+			return false;
+		kill( pos );
+		maybeCompact();
+		return true;
+	}
+/// Removes all the values for which \c pred(row,col,value) returns true, and calls \c onErase(row,col) for each of them.
+/// Returns the nb of values removed
+	template<typename Pred, typename OnErase>
+	size_t eraseIf( Pred pred, OnErase onErase )
+	{
+		size_t nb = 0;
+		const StorageIndex* outer = _data.outerIndexPtr();
+		const StorageIndex* inner = _data.innerIndexPtr();
+		const T*            val   = _data.valuePtr();
+		for( int c=0; c<_data.outerSize(); c++ )
+			for( StorageIndex i=outer[c]; i<outer[c+1]; i++ )
+				if( !isDead( i ) && pred( inner[i], c, val[i] ) )
+				{
+					kill( i );
+					onErase( inner[i], c );
+					nb++;
+				}
+		maybeCompact();
+		return nb;
+	}
+/// Calls \c f(row,col,value) for each value not erased
+	template<typename Func>
+	void forEachNonZero( Func f ) const
+	{
+		const StorageIndex* outer = _data.outerIndexPtr();
+		const StorageIndex* inner = _data.innerIndexPtr();
+		const T*            val   = _data.valuePtr();
+		for( int c=0; c<_data.outerSize(); c++ )
+			for( StorageIndex i=outer[c]; i<outer[c+1]; i++ )
+				if( !isDead( i ) )
+					f( inner[i], c, val[i] );
+	}
+
+/// Compacts the arrays if the ratio of dead values is above \c _maxDeadRatio. Returns true if done
+	bool maybeCompact()
+	{
+		if( _nbDead == 0 || _nbDead <= _maxDeadRatio * _data.nonZeros() )
+			return false;
+		compact();
+		return true;
+	}
+/// Removes the dead values from the arrays (single pass, in place), then frees the unused memory
+	void compact()
+	{
+		if( _nbDead == 0 )
+			return;
+		StorageIndex* outer = _data.outerIndexPtr();
+		StorageIndex* inner = _data.innerIndexPtr();
+		T*            val   = _data.valuePtr();
+		StorageIndex k = 0;
+		for( int c=0; c<_data.outerSize(); c++ )
+		{
+			StorageIndex start = outer[c];
+			StorageIndex end   = outer[c+1];
+			outer[c] = k;
+			for( StorageIndex i=start; i<end; i++ )
+				if( !isDead( i ) )
+				{
+					if( k != i )
+					{
+						inner[k] = inner[i];
+						val[k]   = std::move( val[i] );
+					}
+					k++;
+				}
+		}
+		outer[_data.outerSize()] = k;
+		_data.data().resize( k, 0 );
+		_data.data().squeeze();
+		_dead.assign( ( k + 63 ) / 64, 0 );
+		_dead.shrink_to_fit();
+		_nbDead = 0;
+		_nbCompactions++;
+	}
+
+/// Memory used by the arrays (allocated, not only used) and the tombstones
+	size_t memoryBytes() const
+	{
+		return ( _data.outerSize() + 1 ) * sizeof(StorageIndex)
+			+ _data.data().allocatedSize() * ( sizeof(StorageIndex) + sizeof(T) )
+			+ _dead.capacity() * sizeof(uint64_t);
+	}
+
+private:
+	void kill( std::ptrdiff_t pos )
+	{
+		assert( !isDead( pos ) );
+		_dead[pos>>6] |= uint64_t(1) << (pos&63);
+		_nbDead++;
+	}
+};
+
+#endif // TOMBSTONE_MATRIX_HPP
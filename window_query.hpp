@@ -0,0 +1,159 @@
+/**
+\file window_query.hpp
+\brief Rectangular window queries: values in rows [r0,r1) x cols [c0,c1), and their number
+
+- \c forEachInWindow() and \c countInWindow() do a binary search for \c r0 (and \c r1) in each column of the window,
+so the cost depends on the window width, not on the nb of values in the columns
+- \c WindowCountSummary gives the count with a cost that does not depend on the window size:
+the matrix is split in tiles of \c B x \c B, and a 2D prefix sum of the tile counts gives the count of all the tiles
+fully inside the window in 4 reads. The 4 borders (less than B rows or columns wide) are counted exactly, with the CSC
+arrays for the left and right ones, and with a row-major copy of the indices for the top and bottom ones.
+*/
+
+#ifndef WINDOW_QUERY_HPP
+#define WINDOW_QUERY_HPP
+
+#include <eigen3/Eigen/SparseCore>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+/// Calls \c f(row,col,value) for each value in rows [r0,r1) x cols [c0,c1) (matrix must be compressed)
+template<typename T, typename Func>
+void
+forEachInWindow( const Eigen::SparseMatrix<T>& mat, int r0, int r1, int c0, int c1, Func f )
+{
+	assert( mat.isCompressed() );
+	const auto* outer = mat.outerIndexPtr();
+	const auto* inner = mat.innerIndexPtr();
+	const T*    val   = mat.valuePtr();
+	for( int c=c0; c<c1; c++ )
+	{
+		const auto* last = inner + outer[c+1];
+		for( const auto* it = std::lower_bound( inner + outer[c], last, r0 ); it != last && *it < r1; ++it )
+			f( *it, c, val[it-inner] );
+	}
+}
+
+/// Nb of values in rows [r0,r1) x cols [c0,c1) (matrix must be compressed)
+template<typename T>
+size_t
+countInWindow( const Eigen::SparseMatrix<T>& mat, int r0, int r1, int c0, int c1 )
+{
+	assert( mat.isCompressed() );
+	const auto* outer = mat.outerIndexPtr();
+	const auto* inner = mat.innerIndexPtr();
+	size_t n = 0;
+	for( int c=c0; c<c1; c++ )
+	{
+		const auto* first = inner + outer[c];
+		const auto* last  = inner + outer[c+1];
+		const auto* it0 = std::lower_bound( first, last, r0 );
+		n += std::lower_bound( it0, last, r1 ) - it0;
+	}
+	return n;
+}
+
+/// Summary structure for window counts whose cost does not depend on the window size
+struct WindowCountSummary
+{
+	int                 _tileSize = 64;
+	size_t              _rows = 0;
+	size_t              _cols = 0;
+	size_t              _nbTileCols = 0;
+	std::vector<size_t> _prefix;   ///< (nbTileRows+1) x (nbTileCols+1): nb of values in tiles [0,i) x [0,j)
+	std::vector<int>    _rowPtr;   ///< row-major copy of the indices (for the top and bottom borders)
+	std::vector<int>    _colIdx;
+	const int*          _outer = nullptr;
+	const int*          _inner = nullptr;
+
+/// Builds the summary of matrix \c mat (compressed), that must outlive it
+	template<typename T>
+	void build( const Eigen::SparseMatrix<T>& mat, int tileSize=64 )
+	{
+		static_assert( sizeof(typename Eigen::SparseMatrix<T>::StorageIndex) == sizeof(int), "int indices expected" );
+		assert( mat.isCompressed() );
+		_tileSize = tileSize;
+		_rows = mat.rows();
+		_cols = mat.cols();
+		_outer = mat.outerIndexPtr();
+		_inner = mat.innerIndexPtr();
+		size_t nbTileRows = ( _rows + tileSize - 1 ) / tileSize;
+		_nbTileCols = ( _cols + tileSize - 1 ) / tileSize;
+
+		_prefix.assign( ( nbTileRows + 1 ) * ( _nbTileCols + 1 ), 0 );
+		_rowPtr.assign( _rows + 1, 0 );
+		for( size_t c=0; c<_cols; c++ )
+			for( int i=_outer[c]; i<_outer[c+1]; i++ )
+			{
+				_prefix[ ( _inner[i]/tileSize + 1 ) * ( _nbTileCols + 1 ) + c/tileSize + 1 ]++;
+				_rowPtr[ _inner[i] + 1 ]++;
+			}
+		for( size_t i=1; i<=nbTileRows; i++ )
+			for( size_t j=1; j<=_nbTileCols; j++ )
+				_prefix[ i*(_nbTileCols+1) + j ] += _prefix[ (i-1)*(_nbTileCols+1) + j ]
+					+ _prefix[ i*(_nbTileCols+1) + j-1 ] - _prefix[ (i-1)*(_nbTileCols+1) + j-1 ];
+
+		for( size_t r=0; r<_rows; r++ )
+			_rowPtr[r+1] += _rowPtr[r];
+		_colIdx.resize( mat.nonZeros() );
+		std::vector<int> pos( _rowPtr.begin(), _rowPtr.end()-1 );
+		for( size_t c=0; c<_cols; c++ )                        // columns in increasing order,
+			for( int i=_outer[c]; i<_outer[c+1]; i++ )         // so each row gets sorted column indices
+				_colIdx[ pos[_inner[i]]++ ] = c;
+	}
+
+/// Nb of values in rows [r0,r1) x cols [c0,c1)
+	size_t count( int r0, int r1, int c0, int c1 ) const
+	{
+		if( r0 >= r1 || c0 >= c1 )
+			return 0;
+		int B = _tileSize;
+		int tr0 = ( r0 + B - 1 ) / B, tr1 = r1 / B;   // tiles fully inside
+		int tc0 = ( c0 + B - 1 ) / B, tc1 = c1 / B;
+		if( tr0 >= tr1 || tc0 >= tc1 ) // no full tile: window is less than 2 tiles high or wide
+			return c1 - c0 <= r1 - r0 ? countByCols( r0, r1, c0, c1 ) : countByRows( r0, r1, c0, c1 );
+
+		size_t w = _nbTileCols + 1;
+		size_t n = _prefix[tr1*w + tc1] - _prefix[tr0*w + tc1] - _prefix[tr1*w + tc0] + _prefix[tr0*w + tc0];
+		n += countByCols( r0, r1, c0, tc0*B );          // left
+		n += countByCols( r0, r1, tc1*B, c1 );          // right
+		n += countByRows( r0, tr0*B, tc0*B, tc1*B );    // top
+		n += countByRows( tr1*B, r1, tc0*B, tc1*B );    // bottom
+		return n;
+	}
+
+/// Memory used, in bytes
+	size_t memoryBytes() const
+	{
+		return _prefix.capacity() * sizeof(size_t) + ( _rowPtr.capacity() + _colIdx.capacity() ) * sizeof(int);
+	}
+
+private:
+	size_t countByCols( int r0, int r1, int c0, int c1 ) const
+	{
+		size_t n = 0;
+		for( int c=c0; c<c1; c++ )
+		{
+			const int* first = _inner + _outer[c];
+			const int* last  = _inner + _outer[c+1];
+			const int* it0 = std::lower_bound( first, last, r0 );
+			n += std::lower_bound( it0, last, r1 ) - it0;
+		}
+		return n;
+	}
+	size_t countByRows( int r0, int r1, int c0, int c1 ) const
+	{
+		size_t n = 0;
+		for( int r=r0; r<r1; r++ )
+		{
+			const int* first = _colIdx.data() + _rowPtr[r];
+			const int* last  = _colIdx.data() + _rowPtr[r+1];
+			const int* it0 = std::lower_bound( first, last, c0 );
+			n += std::lower_bound( it0, last, c1 ) - it0;
+		}
+		return n;
+	}
+};
+
+#endif // WINDOW_QUERY_HPP